@@ -6,27 +6,107 @@
 #include "doctest.h"
 #endif
 
+#include <filesystem>
 #include <iostream>
+#include <memory>
 #include <stdlib.h>
+#include <string>
+#include <vector>
 
+#include "batch.h"
 #include "exampleConfig.h"
 #include "lex.h"
+#include "metrics.h"
 #include "plog/Initializers/RollingFileInitializer.h"
 #include "reader.h"
+#include "token_cache.h"
+#include "trace.h"
 #include "type.h"
 #include <fmt/core.h>
 #include <plog/Appenders/ColorConsoleAppender.h>
 #include <plog/Log.h>
 #include <tsl/htrie_set.h>
 
-int main() {
+int main(int argc, char **argv) {
   static plog::ColorConsoleAppender<plog::TxtFormatter> consoleAppender;
   plog::init(plog::debug, &consoleAppender); // Step2: initialize the logger
-  std::cout << fmt::format("the token is {:d}", Token(OpType::ADD))
-            << std::endl;
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0]
+              << " [--cache=DIR] [--metrics=log|json|prometheus]"
+              << " <file | directory | @list>..." << std::endl;
+    return 1;
+  }
+  std::vector<std::string> args;
+  std::unique_ptr<TokenCache> cache;
+  std::string metrics_format;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--cache=", 0) == 0) {
+      cache.reset(new TokenCache(arg.substr(8)));
+    } else if (arg.rfind("--metrics=", 0) == 0) {
+      metrics_format = arg.substr(10);
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (args.empty()) {
+    std::cerr << "no input files" << std::endl;
+    return 1;
+  }
+  if (!metrics_format.empty() && !metrics::enabled()) {
+    PLOGW << "built without CLEX_METRICS, all counters will be 0";
+  }
 
-  // Lex lex = Lex("1.c");
-  // lex.parse();
-  // lex.report();
-  return 0;
+  // 解析结束后按 --metrics 输出性能计数，json 和 prometheus 写到标准输出
+  auto export_metrics = [&metrics_format] {
+    metrics::Metrics snapshot = metrics::snapshot();
+    if (metrics_format == "log") {
+      snapshot.report();
+    } else if (metrics_format == "json") {
+      fmt::print("{}", snapshot.json());
+    } else if (metrics_format == "prometheus") {
+      fmt::print("{}", snapshot.prometheus());
+    }
+  };
+
+  // 单个文件时逐个输出 Token 到标准输出
+  std::error_code ec;
+  if (args.size() == 1 && args[0][0] != '@' &&
+      !std::filesystem::is_directory(args[0], ec)) {
+    try {
+      TraceSink sink(stdout);
+      Lex lex = Lex(args[0].c_str());
+      lex.set_trace(&sink);
+      lex.set_cache(cache.get());
+      lex.parse();
+      sink.flush();
+      lex.report();
+    } catch (const char *e) {
+      PLOGE << fmt::format("{}: 解析失败, {}", args[0], e);
+      return 1;
+    }
+    export_metrics();
+    return 0;
+  }
+
+  // 批量解析时只输出警告，最后输出每个文件和总的统计
+  std::vector<std::string> files = batch::collect(args);
+  plog::get()->setMaxSeverity(plog::warning);
+  SharedSymbolTable symbols;
+  batch::Result res = batch::run(files, std::thread::hardware_concurrency(),
+                                 cache.get(), &symbols);
+  plog::get()->setMaxSeverity(plog::debug);
+  for (size_t i = 0; i < res.files.size(); i++) {
+    if (!res.errors[i].empty()) {
+      PLOGE << fmt::format("{}: 解析失败, {}", res.files[i], res.errors[i]);
+      continue;
+    }
+    const LexStats &stats = res.stats[i];
+    PLOGI << fmt::format("{}: 行数 {}, 字符 {}, Token {}", res.files[i],
+                         stats.rows, stats.chars, stats.tokens);
+  }
+  res.total.report();
+  PLOGI << "不同标识符个数: " << symbols.size();
+  export_metrics();
+  return res.failed == 0 ? 0 : 1;
 }
@@ -0,0 +1,157 @@
+// clex_bench：在合成的 C 源码上测量 Reader、parse() 和 report() 的速度
+// 用法：clex_bench [--size=MiB] [--repeat=N] [--dir=DIR]
+
+#include "corpus.h"
+#include "lex.h"
+#include "reader.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <new>
+#include <plog/Appenders/IAppender.h>
+#include <plog/Init.h>
+#include <plog/Log.h>
+#include <string>
+
+// 全局 operator new 计数，用来算每个 Token 的分配次数
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// 丢弃所有日志，report() 和警告只计格式化的开销
+class NullAppender : public plog::IAppender {
+public:
+  void write(const plog::Record &) override {}
+};
+
+struct Phase {
+  double seconds = 0;
+  size_t allocations = 0;
+};
+
+// 运行 repeat 次取最快的一次
+template <class F> Phase measure(size_t repeat, F f) {
+  Phase best;
+  for (size_t i = 0; i < repeat; i++) {
+    size_t before = allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    if (i == 0 || seconds < best.seconds) {
+      best.seconds = seconds;
+      best.allocations =
+          allocations.load(std::memory_order_relaxed) - before;
+    }
+  }
+  return best;
+}
+
+size_t option(int argc, char **argv, const char *name, size_t fallback) {
+  std::string prefix = fmt::format("--{}=", name);
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind(prefix, 0) == 0) {
+      return std::stoul(arg.substr(prefix.size()));
+    }
+  }
+  return fallback;
+}
+
+std::string option(int argc, char **argv, const char *name,
+                   const std::string &fallback) {
+  std::string prefix = fmt::format("--{}=", name);
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind(prefix, 0) == 0) {
+      return arg.substr(prefix.size());
+    }
+  }
+  return fallback;
+}
+
+void write_file(const std::string &path, const std::string &content) {
+  FILE *f = std::fopen(path.c_str(), "wb");
+  if (f == nullptr) {
+    throw "can not write the corpus file";
+  }
+  size_t written = std::fwrite(content.data(), 1, content.size(), f);
+  if (std::fclose(f) != 0 || written != content.size()) {
+    throw "can not write the corpus file";
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  static NullAppender appender;
+  plog::init(plog::info, &appender);
+
+  size_t size = option(argc, argv, "size", size_t(16)) << 20;
+  size_t repeat = option(argc, argv, "repeat", size_t(5));
+  std::string dir =
+      option(argc, argv, "dir",
+             (std::filesystem::temp_directory_path() / "clex_bench").string());
+  std::filesystem::create_directories(dir);
+
+  fmt::print("{:<8} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+             "corpus", "MiB", "read MB/s", "parse MB/s", "Mtok/s",
+             "alloc/tok", "parse ms", "report ms");
+  for (corpus::Kind kind : corpus::KINDS) {
+    std::string path =
+        (std::filesystem::path(dir) / fmt::format("{}.c", corpus::name(kind)))
+            .string();
+    write_file(path, corpus::generate(kind, size));
+
+    // 只逐字节走一遍 Reader，不做分词，也不建换行索引
+    volatile size_t sink = 0;
+    Phase read = measure(repeat, [&] {
+      Reader reader(path.c_str());
+      size_t sum = 0;
+      while (!reader.is_eof()) {
+        sum += static_cast<unsigned char>(reader.peek());
+        reader.ahead();
+      }
+      sink = sum;
+    });
+
+    size_t tokens = 0;
+    size_t chars = 0;
+    Phase parse = measure(repeat, [&] {
+      Lex lex(path.c_str());
+      lex.parse();
+      tokens = lex.tokens().size();
+      chars = lex.stats().chars;
+    });
+
+    Lex lex(path.c_str());
+    lex.parse();
+    Phase report = measure(repeat, [&] { lex.report(); });
+
+    double mb = static_cast<double>(chars) / 1e6;
+    fmt::print("{:<8} {:>8.1f} {:>10.1f} {:>10.1f} {:>10.2f} {:>10.3f} "
+               "{:>10.2f} {:>10.3f}\n",
+               corpus::name(kind), static_cast<double>(chars) / (1 << 20),
+               mb / read.seconds, mb / parse.seconds,
+               static_cast<double>(tokens) / parse.seconds / 1e6,
+               static_cast<double>(parse.allocations) /
+                   static_cast<double>(tokens == 0 ? 1 : tokens),
+               parse.seconds * 1e3, report.seconds * 1e3);
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+#include "corpus.h"
+#include <fmt/format.h>
+#include <initializer_list>
+
+namespace corpus {
+
+namespace {
+
+// splitmix64，不用 <random> 的分布，保证各个标准库生成的内容一致
+class Rng {
+public:
+  explicit Rng(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (this->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // [0, n)
+  size_t below(size_t n) { return this->next() % n; }
+
+  template <class T, size_t N> const T &pick(const T (&items)[N]) {
+    return items[this->below(N)];
+  }
+
+private:
+  uint64_t state;
+};
+
+const char *const WORDS[] = {
+    "count",  "index", "buffer", "length", "node",   "value",
+    "result", "state", "offset", "table",  "cursor", "limit",
+    "parent", "child", "key",    "entry",  "flags",  "size"};
+
+const char *const TYPES[] = {"int",  "long",     "char",   "unsigned",
+                             "short", "double",  "float",  "size_t",
+                             "struct node *",    "const char *"};
+
+const char *const BINARY[] = {"+",  "-",  "*",  "/",  "%",  "<<", ">>",
+                              "&",  "|",  "^",  "&&", "||", "==", "!=",
+                              "<",  "<=", ">",  ">="};
+
+const char *const ASSIGN[] = {"=",  "+=", "-=",  "*=",  "/=", "%=",
+                              "&=", "|=", "^=", "<<=", ">>="};
+
+const char *const ESCAPES[] = {"\\n", "\\t", "\\\\", "\\\"", "\\0"};
+
+std::string ident(Rng &rng) {
+  std::string res = rng.pick(WORDS);
+  for (size_t i = rng.below(3); i > 0; i--) {
+    res += '_';
+    res += rng.pick(WORDS);
+  }
+  if (rng.below(2) == 0) {
+    res += std::to_string(rng.below(100));
+  }
+  return res;
+}
+
+std::string number(Rng &rng) {
+  switch (rng.below(4)) {
+  case 0:
+    return std::to_string(rng.below(1000000));
+  case 1:
+    return fmt::format("0x{:x}", rng.below(0x100000));
+  case 2: {
+    size_t whole = rng.below(1000);
+    return fmt::format("{}.{}", whole, rng.below(1000));
+  }
+  default: {
+    size_t whole = 1 + rng.below(9);
+    size_t frac = rng.below(100);
+    return fmt::format("{}.{}e{}", whole, frac, rng.below(20));
+  }
+  }
+}
+
+std::string string(Rng &rng) {
+  std::string res = "\"";
+  for (size_t i = 1 + rng.below(6); i > 0; i--) {
+    res += rng.pick(WORDS);
+    res += rng.below(3) == 0 ? rng.pick(ESCAPES) : " ";
+  }
+  res += '"';
+  return res;
+}
+
+std::string character(Rng &rng) {
+  if (rng.below(4) == 0) {
+    return fmt::format("'{}'", rng.pick(ESCAPES));
+  }
+  return fmt::format("'{}'", static_cast<char>('a' + rng.below(26)));
+}
+
+std::string var(Rng &rng) {
+  return std::string(1, static_cast<char>('a' + rng.below(26)));
+}
+
+// 函数参数的求值顺序不确定，花括号列表则从左到右求值，多次取随机数时用它拼接
+void append(std::string &out, std::initializer_list<std::string> pieces) {
+  for (const std::string &piece : pieces) {
+    out += piece;
+  }
+}
+
+// 声明和赋值为主，大部分 Token 是标识符和关键字
+void ident_line(Rng &rng, std::string &out) {
+  if (rng.below(3) == 0) {
+    append(out, {rng.pick(TYPES), " ", ident(rng), " = ", ident(rng), "(",
+                 ident(rng), ", ", ident(rng), ");\n"});
+  } else if (rng.below(2) == 0) {
+    append(out, {"if (", ident(rng), " ", rng.pick(BINARY), " ", ident(rng),
+                 ") return ", ident(rng), ";\n"});
+  } else {
+    append(out, {ident(rng), ".", ident(rng), " = ", ident(rng), "->",
+                 ident(rng), ";\n"});
+  }
+}
+
+// 块注释、行注释和少量代码交替
+void comment_line(Rng &rng, std::string &out) {
+  switch (rng.below(4)) {
+  case 0: {
+    out += "/*";
+    for (size_t i = 2 + rng.below(4); i > 0; i--) {
+      out += " *";
+      for (size_t j = 4 + rng.below(8); j > 0; j--) {
+        out += ' ';
+        out += rng.pick(WORDS);
+      }
+      out += '\n';
+    }
+    out += " */\n";
+    break;
+  }
+  case 1:
+  case 2: {
+    out += "//";
+    for (size_t j = 6 + rng.below(10); j > 0; j--) {
+      out += ' ';
+      out += rng.pick(WORDS);
+    }
+    out += '\n';
+    break;
+  }
+  default:
+    append(out, {ident(rng), " = ", ident(rng), "; // ", rng.pick(WORDS),
+                 "\n"});
+    break;
+  }
+}
+
+// 数组初始化，几乎全是数字、字符串和字符
+void literal_line(Rng &rng, std::string &out) {
+  append(out, {ident(rng), " = {"});
+  for (size_t i = 3 + rng.below(6); i > 0; i--) {
+    switch (rng.below(3)) {
+    case 0:
+      out += number(rng);
+      break;
+    case 1:
+      out += string(rng);
+      break;
+    default:
+      out += character(rng);
+      break;
+    }
+    out += i > 1 ? ", " : "";
+  }
+  out += "};\n";
+}
+
+// 单字母变量之间堆满运算符和括号
+void punct_line(Rng &rng, std::string &out) {
+  append(out, {var(rng), " ", rng.pick(ASSIGN), " "});
+  for (size_t i = 2 + rng.below(6); i > 0; i--) {
+    switch (rng.below(5)) {
+    case 0:
+      append(out, {"(", var(rng), "[", var(rng), "]->", var(rng), ")"});
+      break;
+    case 1:
+      append(out, {"~", var(rng)});
+      break;
+    case 2:
+      append(out, {"!(", var(rng), "++)"});
+      break;
+    case 3:
+      append(out, {"(--", var(rng), " ? ", var(rng), " : ", var(rng), ")"});
+      break;
+    default:
+      out += var(rng);
+      break;
+    }
+    out += i > 1 ? rng.pick(BINARY) : ";\n";
+  }
+}
+
+} // namespace
+
+const char *name(Kind kind) {
+  switch (kind) {
+  case Kind::Ident:
+    return "ident";
+  case Kind::Comment:
+    return "comment";
+  case Kind::Literal:
+    return "literal";
+  case Kind::Punct:
+    return "punct";
+  }
+  return "";
+}
+
+std::string generate(Kind kind, size_t size, uint64_t seed) {
+  Rng rng(seed * 4 + static_cast<uint64_t>(kind));
+  std::string out;
+  out.reserve(size + 256);
+  while (out.size() < size) {
+    switch (kind) {
+    case Kind::Ident:
+      ident_line(rng, out);
+      break;
+    case Kind::Comment:
+      comment_line(rng, out);
+      break;
+    case Kind::Literal:
+      literal_line(rng, out);
+      break;
+    case Kind::Punct:
+      punct_line(rng, out);
+      break;
+    }
+  }
+  return out;
+}
+
+} // namespace corpus
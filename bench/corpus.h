@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace corpus {
+
+/**
+   合成输入的种类，分别偏重标识符、注释、字面量和运算符
+ */
+enum class Kind { Ident, Comment, Literal, Punct };
+
+const Kind KINDS[] = {Kind::Ident, Kind::Comment, Kind::Literal, Kind::Punct};
+
+const char *name(Kind kind);
+
+/**
+   生成大约 size 字节的 C 源码，以完整的一行结尾
+   只依赖 kind、size 和 seed，不同平台、不同次运行得到的内容相同
+ */
+std::string generate(Kind kind, size_t size, uint64_t seed = 1);
+
+} // namespace corpus
@@ -2,11 +2,34 @@ set(CMAKE_MODULE_PATH ${CMAKE_MODULE_PATH} "${CMAKE_CURRENT_LIST_DIR}/cmake/")
 include(HatTrie)
 include(GLog)
 include(Warnings)
+find_package(Threads REQUIRED)
+# 0: no logging, 1: warnings only, 2: also log every token through plog
+set(CLEX_TRACE_LEVEL 1 CACHE STRING "Compile-time log level of the lexer (0-2)")
+# per-thread timers and token counters, see include/metrics.h
+option(CLEX_METRICS "Collect lexer performance counters" OFF)
+# check every number literal against the old regex (slow, for debugging only)
+option(CLEX_NUMBER_ORACLE "Cross-check the number DFA against the regex" OFF)
 add_subdirectory("${CMAKE_CURRENT_LIST_DIR}/external/fmt" EXCLUDE_FROM_ALL)
 set(SOURCES          # All .cpp files in src/
+   ${CMAKE_CURRENT_LIST_DIR}/src/arena.cpp
    ${CMAKE_CURRENT_LIST_DIR}/src/reader.cpp
    ${CMAKE_CURRENT_LIST_DIR}/src/type.cpp
    ${CMAKE_CURRENT_LIST_DIR}/src/lex.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/number.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/scan.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/token_stream.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/lex_stats.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/pool.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/batch.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/trace.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/token_file.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/hash.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/token_cache.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/metrics.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/symbol_table.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/shared_symbol_table.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/diagnostic.cpp
+   ${CMAKE_CURRENT_LIST_DIR}/src/read_ahead.cpp
 )
 set(LIBRARY_NAME clex)  # Default name for the library built from src/*.cpp (change if you wish)
 
@@ -20,10 +43,19 @@ add_library(${LIBRARY_NAME} OBJECT ${SOURCES})
 target_include_directories(${LIBRARY_NAME} PUBLIC ${CMAKE_CURRENT_LIST_DIR}/include)
 
 # There's also (probably) doctests within the library, so we need to see this as well.
+target_link_libraries(${LIBRARY_NAME} PUBLIC doctest)
 target_link_libraries(${LIBRARY_NAME} PUBLIC hat-trie)
 target_link_libraries(${LIBRARY_NAME} PUBLIC glog)
 target_link_libraries(${LIBRARY_NAME} PUBLIC fmt::fmt)
+target_link_libraries(${LIBRARY_NAME} PUBLIC Threads::Threads)
 target_include_directories(${LIBRARY_NAME} PUBLIC ${CMAKE_CURRENT_LIST_DIR}/external/fmt/include)
+target_compile_definitions(${LIBRARY_NAME} PRIVATE CLEX_TRACE_LEVEL=${CLEX_TRACE_LEVEL})
+if(CLEX_METRICS)
+  target_compile_definitions(${LIBRARY_NAME} PRIVATE CLEX_METRICS=1)
+endif()
+if(CLEX_NUMBER_ORACLE)
+  target_compile_definitions(${LIBRARY_NAME} PRIVATE CLEX_NUMBER_ORACLE=1)
+endif()
 
 # Set the compile options you want (change as needed).
 target_set_warnings(${LIBRARY_NAME} ENABLE ALL AS_ERROR ALL DISABLE Annoying)
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+const size_t ARENA_SLAB = 64 * 1024;
+
+/**
+   按块分配的线性内存池，只能整体释放
+   Lex 用它保存需要拷贝出来的单词内容
+ */
+class Arena {
+public:
+  Arena(size_t slab_size = ARENA_SLAB);
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+     分配 size 个字节，按 align 对齐
+   */
+  char *allocate(size_t size, size_t align = 1);
+
+  /**
+     把 text 拷贝进内存池，返回指向副本的视图
+   */
+  std::string_view copy(std::string_view text);
+
+  /**
+     一次释放所有内存，只保留第一块供之后复用
+   */
+  void reset();
+
+  /**
+     已分配出去的字节数
+   */
+  size_t used() const;
+
+  /**
+     向系统申请的字节数
+   */
+  size_t reserved() const;
+
+private:
+  struct Slab {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  std::vector<Slab> slabs;
+  size_t slab_size;
+
+  // 当前块中下一个可用位置
+  char *cursor;
+  char *limit;
+
+  size_t used_;
+  size_t reserved_;
+
+  void grow(size_t size);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include "lex_stats.h"
+#include "shared_symbol_table.h"
+#include "token_cache.h"
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace batch {
+
+/**
+   展开命令行参数
+   普通文件原样保留，目录递归收集其中的 .c / .h 文件，
+   @file 逐行读取其中的路径，每一行同样可以是目录或 @file
+ */
+std::vector<std::string> collect(const std::vector<std::string> &args);
+
+struct Result {
+  // 按传入的顺序
+  std::vector<std::string> files;
+  std::vector<LexStats> stats;
+  // 解析失败的文件对应的错误信息，成功时为空，失败的文件统计为 0
+  std::vector<std::string> errors;
+  size_t failed = 0;
+  LexStats total;
+};
+
+/**
+   每个文件一个 Lex，在线程池上并行解析，按文件大小从大到小调度
+   cache 不为空时各个文件共用这个缓存，symbols 不为空时标识符都在其中编号
+   单个文件出错时记录在 errors 中，不影响其余文件，由调用方负责输出
+ */
+Result run(std::vector<std::string> files,
+           size_t threads = std::thread::hardware_concurrency(),
+           TokenCache *cache = nullptr, SharedSymbolTable *symbols = nullptr);
+
+} // namespace batch
@@ -0,0 +1,85 @@
+#pragma once
+#include "arena.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 每个 Lex 最多保存的诊断条数，超出的只计数
+const size_t DIAGNOSTIC_LIMIT = 1000;
+
+// 预先分配的条数
+const size_t DIAGNOSTIC_RESERVE = 64;
+
+// Diagnostic::Kind 的个数
+const size_t DIAGNOSTIC_KINDS = 4;
+
+/**
+   一条词法错误
+   位置只记字节范围，需要行列时由 Lex::position 计算
+ */
+struct Diagnostic {
+  enum class Kind {
+    BadNumber,
+    UnterminatedString,
+    UnterminatedChar,
+    BadCharLength,
+  };
+
+  Kind kind;
+  size_t offset;
+  size_t length;
+  // 出错的单词，指向输入或 DiagnosticBuffer 的内存
+  std::string_view text;
+  // 去重后相同错误出现的次数，offset 是第一次出现的位置
+  size_t count;
+
+  /**
+     不带位置的描述，如 "the number 09 is not correct"
+   */
+  std::string message() const;
+};
+
+/**
+   收集诊断的缓冲，解析时只追加记录，格式化和输出留到解析之后
+   同一种错误、同样的单词只保存一条并累计次数，超过上限的丢弃并计数
+ */
+class DiagnosticBuffer {
+public:
+  DiagnosticBuffer(size_t limit = DIAGNOSTIC_LIMIT, bool dedupe = true);
+
+  DiagnosticBuffer(const DiagnosticBuffer &) = delete;
+  DiagnosticBuffer &operator=(const DiagnosticBuffer &) = delete;
+
+  /**
+     copy 为 true 时把 text 拷贝到自己的内存，用于会被覆盖的非连续输入缓冲
+   */
+  void add(Diagnostic::Kind kind, size_t offset, std::string_view text,
+           bool copy, size_t count = 1);
+
+  const std::vector<Diagnostic> &items() const;
+
+  /**
+     因为超过上限没有保存的条数
+   */
+  size_t dropped() const;
+
+  void set_limit(size_t limit);
+
+  /**
+     直接计入丢弃的条数，用于从缓存恢复
+   */
+  void drop(size_t count);
+
+private:
+  std::vector<Diagnostic> _items;
+  size_t limit;
+  bool dedupe;
+  size_t _dropped;
+
+  // 按种类分开的 单词 -> 下标
+  std::unordered_map<std::string_view, size_t> seen[DIAGNOSTIC_KINDS];
+
+  Arena arena;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace hash {
+
+/**
+   XXH64，结果和 xxHash 的参考实现一致
+ */
+uint64_t xxh64(const void *data, size_t size, uint64_t seed = 0);
+
+/**
+   FNV-1a，标识符这类很短的字符串比 XXH64 快
+ */
+inline uint64_t fnv1a(const void *data, size_t size) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+} // namespace hash
@@ -0,0 +1,129 @@
+#pragma once
+#include "type.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+   保留字的完美哈希，编译期由 (长度, 首字符, 尾字符) 生成
+   查找时只需一次哈希和一次定长比较
+ */
+namespace keyword {
+
+struct Entry {
+  std::string_view name;
+  ReservedWordType type;
+};
+
+constexpr Entry entries[] = {
+    {"char", ReservedWordType::CHAR},
+    {"unsigned", ReservedWordType::UNSIGNED},
+    {"union", ReservedWordType::UNION},
+    {"int", ReservedWordType::INT},
+    {"signer", ReservedWordType::SIGNER},
+    {"typedef", ReservedWordType::TYPEDEF},
+    {"long", ReservedWordType::LONG},
+    {"const", ReservedWordType::CONST},
+    {"sizeof", ReservedWordType::SIZEOF},
+    {"float", ReservedWordType::FLOAT},
+    {"static", ReservedWordType::STATIC},
+    {"if", ReservedWordType::IF},
+    {"double", ReservedWordType::DOUBLE},
+    {"extern", ReservedWordType::EXTERN},
+    {"else", ReservedWordType::ELSE},
+    {"void", ReservedWordType::VOID},
+    {"struct", ReservedWordType::STRUCT},
+};
+
+// entries 按 ReservedWordType 的顺序排列，spelling() 直接按下标取
+constexpr bool in_enum_order() {
+  for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+    if (static_cast<size_t>(entries[i].type) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(in_enum_order(), "keyword::entries must follow ReservedWordType");
+
+const size_t TABLE_SIZE = 32;
+
+constexpr size_t hash(size_t len, char first, char last, size_t a,
+                      size_t b) {
+  return (len * a + static_cast<uint8_t>(first) * b +
+          static_cast<uint8_t>(last)) %
+         TABLE_SIZE;
+}
+
+struct Params {
+  size_t a;
+  size_t b;
+  size_t min_len;
+  size_t max_len;
+};
+
+// 找一组没有冲突的系数
+constexpr Params search() {
+  size_t min_len = SIZE_MAX, max_len = 0;
+  for (const Entry &e : entries) {
+    min_len = e.name.size() < min_len ? e.name.size() : min_len;
+    max_len = e.name.size() > max_len ? e.name.size() : max_len;
+  }
+  for (size_t a = 1; a < 64; a++) {
+    for (size_t b = 1; b < 64; b++) {
+      bool used[TABLE_SIZE] = {};
+      bool ok = true;
+      for (const Entry &e : entries) {
+        size_t h = hash(e.name.size(), e.name.front(), e.name.back(), a, b);
+        if (used[h]) {
+          ok = false;
+          break;
+        }
+        used[h] = true;
+      }
+      if (ok) {
+        return Params{a, b, min_len, max_len};
+      }
+    }
+  }
+  return Params{0, 0, min_len, max_len};
+}
+
+constexpr Params params = search();
+static_assert(params.a != 0, "no perfect hash for the reserved words");
+
+constexpr std::array<int8_t, TABLE_SIZE> make_table() {
+  std::array<int8_t, TABLE_SIZE> res{};
+  for (auto &slot : res) {
+    slot = -1;
+  }
+  for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+    const Entry &e = entries[i];
+    res[hash(e.name.size(), e.name.front(), e.name.back(), params.a,
+             params.b)] = static_cast<int8_t>(i);
+  }
+  return res;
+}
+
+constexpr std::array<int8_t, TABLE_SIZE> table = make_table();
+
+/**
+   text 是否是保留字
+ */
+constexpr std::optional<ReservedWordType> find(std::string_view text) {
+  if (text.size() < params.min_len || text.size() > params.max_len) {
+    return std::nullopt;
+  }
+  int8_t i = table[hash(text.size(), text.front(), text.back(), params.a,
+                        params.b)];
+  if (i < 0 || entries[i].name != text) {
+    return std::nullopt;
+  }
+  return entries[i].type;
+}
+
+static_assert(find("struct") == ReservedWordType::STRUCT, "");
+static_assert(!find("structs").has_value(), "");
+
+} // namespace keyword
@@ -1,54 +1,272 @@
 #pragma once
+#include "arena.h"
+#include "diagnostic.h"
+#include "lex_stats.h"
 #include "reader.h"
+#include "shared_symbol_table.h"
+#include "symbol_table.h"
+#include "token_stream.h"
+#include "trace.h"
 #include "type.h"
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <memory>
-#include <tsl/htrie_map.h>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
-const tsl::htrie_map<char, ReservedWordType>
-    reserved_word({{"char", ReservedWordType::CHAR},
-                   {"unsigned", ReservedWordType::UNSIGNED},
-                   {"union", ReservedWordType::UNION},
-                   {"int", ReservedWordType::INT},
-                   {"signer", ReservedWordType::SIGNER},
-                   {"typedef", ReservedWordType::TYPEDEF},
-                   {"long", ReservedWordType::LONG},
-                   {"const", ReservedWordType::CONST},
-                   {"sizeof", ReservedWordType::SIZEOF},
-                   {"float", ReservedWordType::FLOAT},
-                   {"static", ReservedWordType::STATIC},
-                   {"if", ReservedWordType::IF},
-                   {"double", ReservedWordType::DOUBLE},
-                   {"extern", ReservedWordType::EXTERN},
-                   {"else", ReservedWordType::ELSE},
-                   {"void", ReservedWordType::VOID},
-                   {"struct", ReservedWordType::STRUCT}});
+// 分词规则变化时加一，让旧的 Token 缓存失效
+const uint32_t LEXER_VERSION = 1;
+
+class TokenCache;
+
+// 并行解析时每个分块的最小字节数，更小的输入直接顺序解析
+const size_t PARALLEL_MIN_CHUNK = 256 * 1024;
+
+/**
+   对输入的一次修改：从 offset 开始删除 removed 个字节，插入 inserted 个字节
+ */
+struct Edit {
+  size_t offset;
+  size_t removed;
+  size_t inserted;
+};
+
+/**
+   修改前后 Token 序列的差异
+   旧序列中 [first, first + removed) 被 inserted 替换，之后的旧 Token 偏移加上 delta
+   inserted 中的标识符没有符号编号，需要时按拼写在自己的符号表中查找
+ */
+struct TokenDiff {
+  size_t first;
+  size_t removed;
+  // 单词内容指向修改后的输入
+  std::vector<Token> inserted;
+  std::ptrdiff_t delta;
+  // inserted 范围内的词法错误，单词同样指向修改后的输入
+  std::vector<Diagnostic> diagnostics;
+};
 
 class Lex {
 public:
+  /**
+     逐个拉取 Token 的输入迭代器，for (const Token &t : lex) 边读边解析
+   */
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Token *;
+    using reference = const Token &;
+
+    iterator();
+    explicit iterator(Lex *lex);
+
+    const Token &operator*() const { return this->token; }
+    const Token *operator->() const { return &this->token; }
+
+    iterator &operator++();
+
+    bool operator==(const iterator &other) const {
+      return this->lex == other.lex;
+    }
+    bool operator!=(const iterator &other) const {
+      return this->lex != other.lex;
+    }
+
+  private:
+    Lex *lex;
+    Token token;
+  };
+
   Lex(const char *path);
 
+  /**
+     直接解析内存中的源码，不复制也不经过文件，和 mmap 的文件一样走连续模式
+     source 由调用者拥有，必须比 Lex 以及取出的 Token 活得久
+   */
+  Lex(std::string_view source);
+
+  /**
+     std::string 既可能是路径也可能是源码，必须显式写成 path.c_str() 或
+     std::string_view(source)
+   */
+  Lex(const std::string &) = delete;
+
   // 解析并输出数据
   void parse();
 
-  // 统计并综合数据
+  /**
+     parse 时把每个 Token 写到 sink，传 nullptr 关闭
+     和编译期的日志级别无关，sink 必须比解析过程活得久
+   */
+  void set_trace(TraceSink *sink);
+
+  /**
+     parse 前先按输入内容在 cache 中查找，命中时直接读取缓存的 Token，
+     否则解析后写入缓存；只对从头解析的连续输入生效，诊断和 Token 一起缓存
+   */
+  void set_cache(TokenCache *cache);
+
+  /**
+     把连续输入按换行切成 threads 块并行解析，结果和 parse 完全相同
+     每块从切点开始推测解析，拼接时从上一块真正结束的位置重新解析，
+     直到和推测结果在同一个 Token 偏移上对齐，之后的推测结果直接采用
+     非连续输入或输入太小时退回 parse
+   */
+  void parse_parallel(size_t threads = std::thread::hardware_concurrency());
+
+  /**
+     增量解析：source 是修改后的连续输入，tokens 是修改前的解析结果
+     从修改处之前最后一个不受影响的 Token 之后开始重新解析，
+     直到新的 Token 和旧序列在修改之后的同一位置对齐为止，
+     耗时只和修改附近的 Token 数有关
+   */
+  static TokenDiff relex(std::string_view source, const TokenStream &tokens,
+                         const Edit &edit);
+
+  /**
+     解析下一个 Token，读到结尾时返回 false
+     返回的 Token 不带位置（用 position 计算）；非连续输入时单词内容
+     指向内部缓冲，只在下一次 next 之前有效
+   */
+  bool next(Token &token);
+
+  /**
+     最多解析 n 个 Token 写入 tokens，返回实际个数
+     单词内容在下一次 next_n 之前有效
+   */
+  size_t next_n(Token *tokens, size_t n);
+
+  iterator begin();
+
+  iterator end();
+
+  // Token 在输入中的位置
+  Position position(const Token &token) const;
+
+  /**
+     只统计不保存 Token，内存占用和输入大小无关，返回值同 stats()
+   */
+  LexStats scan();
+
+  // 已产生的 Token 以及读过的行数、字符数的统计，解析时逐个累计
+  LexStats stats() const;
+
+  // 输出诊断，再统计并综合数据
   void report();
 
-  std::vector<Token> const &tokens() const;
+  /**
+     解析过程中收集的词法错误，按出现的顺序
+   */
+  const std::vector<Diagnostic> &diagnostics() const;
+
+  /**
+     超过上限没有保存的诊断条数
+   */
+  size_t dropped_diagnostics() const;
+
+  void set_diagnostic_limit(size_t limit);
+
+  // 诊断的行列位置
+  Position position(const Diagnostic &diagnostic) const;
+
+  /**
+     带行列和重复次数的一行描述
+   */
+  std::string format(const Diagnostic &diagnostic) const;
+
+  /**
+     用 plog 输出所有诊断，受 CLEX_TRACE_LEVEL 控制
+   */
+  void report_diagnostics() const;
+
+  TokenStream const &tokens() const;
+
+  /**
+     本文件的符号表，按拼写记录出现次数
+     没有设置共享符号表时 Token::symbol 和 TokenStream::symbol 是其中的编号
+   */
+  const SymbolTable &symbols() const;
+
+  /**
+     和其他 Lex 共用的符号表，解析前设置
+     设置后 Token::symbol 改为 shared 中的编号，各个文件之间一致
+   */
+  void set_symbols(SharedSymbolTable *shared);
 
 private:
   std::unique_ptr<Reader> reader;
 
-  std::vector<Token> _tokens;
+  TokenStream _tokens;
+
+  // 非连续输入时 parse 保存的单词内容，连续输入时 Token 直接指向 Reader 的内存
+  // 随 Lex 析构一次性释放
+  Arena arena;
+
+  // next_n 每批的单词内容
+  Arena batch;
+
+  TraceSink *trace_sink;
+
+  SymbolTable _symbols;
+  // 分块和重新解析的 Lex 不编号，由调用者合并结果后统一编号，每个拼写只哈希一次
+  bool interning;
+
+  // 共享符号表，以及本文件编号到共享编号的映射
+  SharedSymbolTable *shared_symbols;
+  std::vector<Symbol> shared_ids;
+
+  // next 每产生一个 Token 计入一次，parse_parallel 和读缓存时按列补上
+  LexStats _stats;
+
+  TokenCache *cache;
+  size_t cache_hits;
+  size_t cache_misses;
+
+  DiagnosticBuffer _diagnostics;
+
+  // parse_parallel 的分块和重新解析使用的 Lex，共享调用者的输入
+  Lex(std::unique_ptr<Reader> reader);
+
+  // 记录一条起点为当前指针的诊断
+  void diagnose(Diagnostic::Kind kind, std::string_view text);
+
+  // 解析到第一个起点不小于 end 的 Token 为止，返回该 Token 的偏移
+  size_t parse_until(size_t end);
+
+  // 标识符的编号，设置了共享符号表时返回共享的编号
+  Symbol intern(std::string_view text);
+
+  // 给 _tokens[from, size) 的标识符重新编号
+  void intern_from(size_t from);
+
+  // next 产生一个 Token 时计入统计
+  void count(const Token &token);
+
+  // 把不是由 next 产生的 _tokens[from, size) 计入统计
+  void count_from(size_t from);
+
+  Token make_op(OpType op);
+
+  Token make_text(Token::TokenType type, std::string_view text);
+
+  // 把 token 的单词内容拷贝到 arena
+  static Token materialize(const Token &token, Arena &arena);
+
+  // 按运算符表做最长匹配，当前字符不是运算符时返回 false
+  bool parse_op(Token &token);
 
-  void parse_ident();
+  Token parse_ident();
 
-  void parse_number();
+  Token parse_number();
 
-  void parse_string();
+  Token parse_string();
 
-  void parse_char();
+  Token parse_char();
 
   void parse_macro_or_line_comment();
 
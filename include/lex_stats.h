@@ -0,0 +1,37 @@
+#pragma once
+#include "type.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+   解析结果的统计，可以按文件合并成总数
+   Lex 在产生 Token 时逐个计入，不需要保存 Token 序列
+ */
+struct LexStats {
+  size_t files = 0;
+  size_t rows = 0;
+  size_t chars = 0;
+  size_t tokens = 0;
+  size_t op = 0;
+  size_t reserved = 0;
+  size_t ident = 0;
+  size_t number = 0;
+  size_t string = 0;
+  size_t char_ = 0;
+  size_t cache_hits = 0;
+  size_t cache_misses = 0;
+  // 按 OpType / ReservedWordType 的下标
+  size_t ops[OP_TYPE_COUNT] = {};
+  size_t reserved_words[RESERVED_WORD_COUNT] = {};
+
+  // 计入一个 Token
+  void add(const Token &token);
+
+  // 按 TokenStream 的列计入，subtype 只对 OP 和 ReservedWord 有意义，必须在范围内
+  void add(Token::TokenType type, uint8_t subtype);
+
+  void merge(const LexStats &other);
+
+  // 输出统计，多个文件时先输出文件个数
+  void report() const;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include "type.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+   分词器的性能计数
+   由 clex.cmake 的 CLEX_METRICS 打开，关闭时分词器里的计数代码整个不参与编译，
+   这里的接口仍然可用，只是计数全为 0
+   每个线程写自己的计数，snapshot 时才加在一起，解析过程中没有共享的写
+ */
+namespace metrics {
+
+/**
+   计时的 parse_* 函数
+ */
+enum class Routine {
+  Op,
+  Ident,
+  Number,
+  String,
+  Char,
+  LineComment,
+  BlockComment,
+};
+
+const size_t ROUTINE_COUNT = 7;
+
+// 计数的 Token 种类，即除 Null 以外的 Token::TokenType
+const size_t KIND_COUNT = 6;
+
+// Token 长度按 2 的幂分桶，第 i 个桶是 [2^i, 2^(i+1))，最后一个桶包含所有更长的
+const size_t LENGTH_BUCKETS = 16;
+
+struct Timer {
+  uint64_t calls = 0;
+  uint64_t ns = 0;
+};
+
+/**
+   所有线程计数的快照
+ */
+struct Metrics {
+  Timer routines[ROUTINE_COUNT];
+  uint64_t tokens[KIND_COUNT] = {};
+  uint64_t bytes[KIND_COUNT] = {};
+  uint64_t lengths[KIND_COUNT][LENGTH_BUCKETS] = {};
+  // 非连续输入读入缓冲的次数
+  uint64_t refills = 0;
+  uint64_t longest = 0;
+  Token::TokenType longest_type = Token::TokenType::Null;
+  // 进程的峰值常驻内存，字节，取不到时为 0
+  uint64_t peak_memory = 0;
+
+  std::string json() const;
+
+  /**
+     Prometheus 文本格式，指标名以 clex_ 开头
+   */
+  std::string prometheus() const;
+
+  /**
+     和 Lex::report 一样用 plog 输出
+   */
+  void report() const;
+};
+
+/**
+   库是否打开了 CLEX_METRICS
+ */
+bool enabled();
+
+Metrics snapshot();
+
+/**
+   清零所有线程的计数，调用时不应有线程正在解析
+ */
+void reset();
+
+const char *name(Routine routine);
+
+const char *name(Token::TokenType type);
+
+void record_time(Routine routine, uint64_t ns);
+
+void record_token(Token::TokenType type, size_t length);
+
+void record_refill();
+
+/**
+   析构时把经过的时间计入 routine，调用过 discard 时不计入
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Routine routine)
+      : routine(routine), start(std::chrono::steady_clock::now()),
+        discarded(false) {}
+
+  ~ScopedTimer() {
+    if (this->discarded) {
+      return;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - this->start)
+                  .count();
+    record_time(this->routine, static_cast<uint64_t>(ns));
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  // 这次调用不算，例如 parse_op 没有匹配到运算符
+  void discard() { this->discarded = true; }
+
+private:
+  Routine routine;
+  std::chrono::steady_clock::time_point start;
+  bool discarded;
+};
+
+} // namespace metrics
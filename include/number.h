@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+/**
+   数字常量的词法规则，等价于
+   ^(\-|\+)?(0|((\d*\.\d+)|(\d+\.\d*))(e(\+|\-)?\d+)?|[1-9]\d*|0[1-7][0-7]*|
+   0x[1-9a-f][0-9a-f]*|0x([1-9a-f][0-9a-f]*\.[0-9a-f]*|[0-9a-f]*\.[1-9a-f][0-9a-f]*)p(\+|\-)?[0-9a-f]+)
+   (ul|lu|l|u)?$
+   编译期生成状态转移表，边扫描边检查
+ */
+namespace number {
+
+using State = uint8_t;
+
+// 初始状态
+const State START = 0;
+
+/**
+   读入一个字符后的状态，进入拒绝状态后不会再离开
+ */
+State step(State state, char c);
+
+/**
+   state 是否是接受状态
+ */
+bool accept(State state);
+
+/**
+   整个 text 是否是合法的数字常量
+ */
+bool is_valid(std::string_view text);
+
+} // namespace number
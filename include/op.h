@@ -0,0 +1,190 @@
+#pragma once
+#include "type.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+   运算符的最长匹配表，编译期由各运算符的写法生成
+   按首字节分组，组内从长到短排列；一次取出最多 3 个字节，
+   和组内的候选逐个做一次掩码比较
+ */
+namespace op {
+
+struct Entry {
+  std::string_view name;
+  OpType type;
+};
+
+constexpr Entry entries[] = {
+    {"=", OpType::ASSIGN},
+    {"+", OpType::ADD},
+    {"++", OpType::INC},
+    {"+=", OpType::ADD_ASSIGN},
+    {"-", OpType::SUB},
+    {"--", OpType::DEC},
+    {"-=", OpType::SUB_ASSIGN},
+    {"*=", OpType::MUL_ASSIGN},
+    {"/", OpType::DIV},
+    {"/=", OpType::DIV_ASSIGN},
+    {"%", OpType::MOD},
+    {"%=", OpType::MOD_ASSIGN},
+    {"&=", OpType::BITWISE_AND_ASSIGN},
+    {"|", OpType::BITWISE_OR},
+    {"|=", OpType::BITWISE_OR_ASSIGN},
+    {"^", OpType::BITWISE_XOR},
+    {"^=", OpType::BITWISE_XOR_ASSIGN},
+    {"~", OpType::BITWISE_NOT},
+    {"&&", OpType::AND},
+    {"&&=", OpType::AND_ASSIGN},
+    {"||", OpType::OR},
+    {"||=", OpType::OR_ASSIGN},
+    {"!", OpType::NOT},
+    {"<<", OpType::SHL},
+    {"<<=", OpType::SHL_ASSIGN},
+    {">>", OpType::SHR},
+    {">>=", OpType::SHR_ASSIGN},
+    {"<", OpType::LESS},
+    {"<=", OpType::LESS_EQUAL},
+    {"==", OpType::EQUAL},
+    {"!=", OpType::INEQUAL},
+    {">", OpType::GREATER},
+    {">=", OpType::GREATER_EQUAL},
+    {"##", OpType::CONCAT},
+    {"*", OpType::ASTERISK},
+    {"&", OpType::AMPERSAND},
+    {"?", OpType::QUESTION},
+    {",", OpType::COMMA},
+    {":", OpType::COLON},
+    {";", OpType::SEMICOLON},
+    {".", OpType::DOT},
+    {"->", OpType::ARROW},
+    {"{", OpType::L_BRACE},
+    {"}", OpType::R_BRACE},
+    {"[", OpType::L_SQUARE},
+    {"]", OpType::R_SQUARE},
+    {"(", OpType::L_PAREN},
+    {")", OpType::R_PAREN},
+};
+
+const size_t COUNT = sizeof(entries) / sizeof(entries[0]);
+
+static_assert(COUNT == OP_TYPE_COUNT, "every OpType needs an entry");
+
+const size_t MAX_LEN = 3;
+
+// entries 按 OpType 的顺序排列，spelling() 直接按下标取
+constexpr bool in_enum_order() {
+  for (size_t i = 0; i < COUNT; i++) {
+    if (static_cast<size_t>(entries[i].type) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(in_enum_order(), "op::entries must follow OpType");
+
+constexpr bool is_prefix(std::string_view prefix) {
+  for (const Entry &e : entries) {
+    if (e.name == prefix) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 每个运算符的前缀本身也是运算符，最长匹配不需要回退
+// '#' 开头的是预处理行，不会走到运算符匹配
+constexpr bool prefixes_are_ops() {
+  for (const Entry &e : entries) {
+    if (e.name.empty() || e.name.size() > MAX_LEN) {
+      return false;
+    }
+    if (e.name.front() == '#') {
+      continue;
+    }
+    for (size_t len = 1; len < e.name.size(); len++) {
+      if (!is_prefix(e.name.substr(0, len))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(prefixes_are_ops(), "every operator prefix must be an operator");
+
+// 前 n 个字节按小端拼成一个整数
+constexpr uint32_t pack(const char *p, size_t n) {
+  uint32_t res = 0;
+  for (size_t i = 0; i < n; i++) {
+    res |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+  }
+  return res;
+}
+
+constexpr uint32_t pack(std::string_view s) {
+  return pack(s.data(), s.size());
+}
+
+struct Candidate {
+  uint32_t bytes;
+  uint32_t mask;
+  uint8_t len;
+  OpType type;
+};
+
+struct Group {
+  uint8_t begin;
+  uint8_t count;
+};
+
+struct Table {
+  std::array<Group, 256> groups;
+  std::array<Candidate, COUNT> candidates;
+};
+
+constexpr Table make_table() {
+  Table res{};
+  size_t k = 0;
+  for (size_t b = 0; b < 256; b++) {
+    res.groups[b].begin = static_cast<uint8_t>(k);
+    for (size_t len = MAX_LEN; len >= 1; len--) {
+      for (const Entry &e : entries) {
+        if (static_cast<uint8_t>(e.name.front()) == b && e.name.size() == len) {
+          res.candidates[k++] =
+              Candidate{pack(e.name),
+                        static_cast<uint32_t>((uint64_t(1) << (8 * len)) - 1),
+                        static_cast<uint8_t>(len), e.type};
+        }
+      }
+    }
+    res.groups[b].count = static_cast<uint8_t>(k - res.groups[b].begin);
+  }
+  return res;
+}
+
+constexpr Table table = make_table();
+
+/**
+   word 的低字节是运算符的第一个字节，只考虑不超过 max_len 的候选
+   返回最长的匹配，没有匹配时返回 nullptr
+ */
+constexpr const Candidate *match(uint32_t word, size_t max_len = MAX_LEN) {
+  const Group &group = table.groups[word & 0xff];
+  for (size_t i = group.begin; i < size_t(group.begin) + group.count; i++) {
+    const Candidate &c = table.candidates[i];
+    if (c.len <= max_len && (word & c.mask) == c.bytes) {
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+static_assert(match(pack(">>=x"))->type == OpType::SHR_ASSIGN, "");
+static_assert(match(pack(">>x"))->type == OpType::SHR, "");
+static_assert(match(pack("><"))->type == OpType::GREATER, "");
+static_assert(match(pack("&&="), 2)->type == OpType::AND, "");
+static_assert(match(pack("a")) == nullptr, "");
+
+} // namespace op
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+   work-stealing 线程池
+   每个线程有自己的任务队列，提交时轮流放入各个队列；线程先按提交顺序取自己队列
+   里的任务，空了再从其他线程的队列里偷，所以先提交的大任务总是先被执行
+ */
+class ThreadPool {
+public:
+  ThreadPool(size_t threads = std::thread::hardware_concurrency());
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+
+  /**
+     等待所有已提交的任务完成
+     任务抛出的第一个异常在这里重新抛出
+   */
+  void wait();
+
+  size_t size() const;
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  // 保护下面的计数，queued 是还在队列里的任务，pending 是还没完成的任务
+  std::mutex mutex;
+  std::condition_variable work_cv;
+  std::condition_variable done_cv;
+  size_t queued;
+  size_t pending;
+  size_t next_queue;
+  bool stopping;
+  std::exception_ptr error;
+
+  bool take(size_t id, std::function<void()> &task);
+
+  void run(size_t id);
+};
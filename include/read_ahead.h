@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+// 每块的大小，是页大小的整数倍
+const size_t READ_AHEAD_BLOCK = 64 * 1024;
+
+// 环中的块数，生产者最多领先消费者这么多块
+const size_t READ_AHEAD_BLOCKS = 4;
+
+const size_t READ_AHEAD_ALIGN = 4096;
+
+/**
+   管道等无法映射的输入的预读
+   后台线程用 read 把数据读进按页对齐、循环使用的块中，块组成单生产者单消费者的环，
+   解析线程只从环中复制，读入和解析同时进行；只有生产者落后时消费者才会等待
+   只在 POSIX 平台上可用
+ */
+class ReadAhead {
+public:
+  /**
+     接管 fd，析构时关闭
+   */
+  ReadAhead(int fd);
+
+  ~ReadAhead();
+
+  ReadAhead(const ReadAhead &) = delete;
+  ReadAhead &operator=(const ReadAhead &) = delete;
+
+  /**
+     复制最多 n 字节到 out，返回实际的字节数
+     环中有数据时不等待，没有时等到至少 1 字节；返回 0 表示输入已经结束
+   */
+  size_t read(char *out, size_t n);
+
+private:
+  struct Block {
+    char *data;
+    size_t size;
+  };
+
+  int fd;
+  // 析构时写入以唤醒阻塞在 poll 上的生产者
+  int wake[2];
+
+  char *memory;
+  Block blocks[READ_AHEAD_BLOCKS];
+
+  // 生产者填好的块数和消费者用完的块数，只增不减，两者之差为环中的块数
+  std::atomic<size_t> produced;
+  std::atomic<size_t> consumed;
+  // 生产者读到结尾或出错，之后不会再有新的块
+  std::atomic<bool> done;
+  std::atomic<bool> stop;
+
+  // 消费者在当前块中的位置
+  size_t cursor;
+
+  // 只用于等待，计数本身不需要加锁
+  std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+
+  std::thread producer;
+
+  void run();
+
+  // 读满一次 read 的结果，返回 false 表示结尾、出错或被唤醒退出
+  bool fill(Block &block);
+
+  void notify(std::condition_variable &cv);
+};
@@ -2,9 +2,16 @@
 #include <cstddef>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
 
 const size_t READER_BUFFER = 1024;
 
+class ReadAhead;
+
 struct Position {
   size_t row;
   size_t col;
@@ -14,9 +21,29 @@ class Reader {
 public:
   /**
      Reader 构造函数
+     普通文件会被 mmap 成一段连续内存，管道等无法映射的输入退回到缓冲读取，
+     POSIX 平台上由 ReadAhead 在后台预读，其余平台使用 ifstream
+     无法打开时抛出异常
    */
   Reader(const char *path);
 
+  /**
+     调用者拥有的一段内存，不复制，按连续模式解析
+     调用者保证 source 比 Reader 活得久
+   */
+  Reader(std::string_view source);
+
+  /**
+     不拥有内存的连续输入，当前指针从 offset 开始
+     偏移仍然相对于整个 source，调用者保证 source 比 Reader 活得久
+   */
+  Reader(std::string_view source, size_t offset);
+
+  ~Reader();
+
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
   /**
      将当前指针前移一位，并把前向指针变为当前指针的前一位
    */
@@ -27,6 +54,21 @@ public:
    */
   void front_ahead();
 
+  /**
+     将前向指针前移 n 位，只用于连续模式
+   */
+  void front_skip(size_t n);
+
+  /**
+     把当前指针移到 offset，只用于连续模式
+   */
+  void seek(size_t offset);
+
+  /**
+     前向指针是否已经越过输入结尾
+   */
+  bool is_front_eof() const;
+
   /**
      返回当前的地址
    */
@@ -43,26 +85,91 @@ public:
   bool is_eof() const;
 
   /**
-   * 返回当前位置
+   * 返回当前位置，需要时才由换行索引计算
    */
   Position pos() const;
 
+  /**
+   * 任意已读过的偏移对应的位置，在换行索引上二分查找
+   */
+  Position locate(size_t offset) const;
+
+  /**
+   * 换行符的偏移
+   * 连续模式下第一次调用时扫描整个输入，否则只包含已经读入的部分
+   */
+  const std::vector<size_t> &lines() const;
+
   /**
    * 字符总数
    */
   size_t count() const;
 
+  /**
+   * 当前指针在输入中的偏移
+   */
+  size_t offset() const;
+
+  /**
+   * 开始记录一个单词，起点为当前指针
+   */
+  void begin_lexeme();
+
+  /**
+   * 结束记录，返回从当前指针到前向指针（不含）之间的内容
+   * 连续模式下直接指向输入，否则指向内部缓冲，下一次 begin_lexeme 前有效
+   */
+  std::string_view end_lexeme();
+
+  /**
+   * 输入是否是一段连续内存（mmap 模式）
+   */
+  bool is_contiguous() const;
+
+  /**
+   * 连续模式下的整个输入，其余情况为空
+   */
+  std::string_view source() const;
+
 private:
   std::ifstream file;
+  // 非连续模式下的预读，为空时从 file 读取
+  std::unique_ptr<ReadAhead> read_ahead_;
+  // 非连续模式下读入返回 0 字节，输入已经结束
+  bool eof_;
+  // 非连续模式下的循环缓冲，数据到 fill_ 为止，前向指针到达 fill_ 时继续读入
   char buffer[READER_BUFFER * 2];
   size_t index;
   size_t front_index;
+  size_t fill_;
+
+  // 换行符的偏移，用于 locate
+  // 连续模式下第一次 locate 时整体扫描一遍，否则在每次读入缓冲时追加
+  mutable std::vector<size_t> lines_;
+  mutable std::once_flag lines_once_;
+
+  // 非连续模式下已经读入的字节数
+  size_t read_offset_;
+
+  // 连续模式下指向整个输入，index / front_index 即为文件偏移
+  const char *data_;
+  size_t size_;
+
+  // 非连续模式下当前指针的偏移
+  size_t offset_;
+
+  // 非连续模式下正在记录的单词
+  bool capturing_;
+  std::string capture_;
 
-  Position p_index;
+  // mmap 得到的映射，析构时解除
+  void *mapping_;
+  size_t mapping_size_;
 
-  Position p_front_index;
+  bool map_file(int fd);
 
-  void read_buffer(char *buffer);
+  // 在 fill_ 处至少读入 1 字节，最多读到所在一半的结尾；输入结束后每次补一个 '\0'
+  void read_buffer();
 
   size_t count_;
 };
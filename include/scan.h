@@ -0,0 +1,65 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+   在连续内存上批量查找字符的函数
+   x86 上运行时选择 AVX2 或 SSE2 实现，其余平台使用逐字节实现
+ */
+namespace scan {
+
+// 块注释结尾 '*' '/' 中 '*' 的下标，找不到时返回 n
+size_t find_comment_end(const char *p, size_t n);
+
+/**
+   第一个不以反斜杠续行的 '\n' 的下标，找不到时返回 n
+   "\\\n" 和 "\\\r\n" 视为续行
+ */
+size_t find_line_end(const char *p, size_t n);
+
+/**
+   把所有 '\n' 的下标加上 base 追加到 out
+ */
+void find_newlines(const char *p, size_t n, size_t base,
+                   std::vector<size_t> &out);
+
+/**
+   开头连续的 [A-Za-z0-9_] 的长度
+ */
+size_t ident_run(const char *p, size_t n);
+
+/**
+   开头连续的 [A-Za-z0-9_.] 的长度
+ */
+size_t number_run(const char *p, size_t n);
+
+// 字符分类表，不依赖 locale
+const uint8_t IDENT_BYTE = 1;
+const uint8_t NUMBER_BYTE = 2;
+
+constexpr std::array<uint8_t, 256> make_byte_classes() {
+  std::array<uint8_t, 256> res{};
+  for (int c = 0; c < 256; c++) {
+    bool alnum = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                 (c >= 'A' && c <= 'Z');
+    if (alnum || c == '_') {
+      res[c] = IDENT_BYTE | NUMBER_BYTE;
+    }
+  }
+  res['.'] = NUMBER_BYTE;
+  return res;
+}
+
+inline constexpr std::array<uint8_t, 256> byte_classes = make_byte_classes();
+
+inline bool is_ident_byte(char c) {
+  return byte_classes[static_cast<unsigned char>(c)] & IDENT_BYTE;
+}
+
+inline bool is_number_byte(char c) {
+  return byte_classes[static_cast<unsigned char>(c)] & NUMBER_BYTE;
+}
+
+} // namespace scan
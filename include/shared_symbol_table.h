@@ -0,0 +1,54 @@
+#pragma once
+#include "symbol_table.h"
+#include "type.h"
+#include <cstddef>
+#include <shared_mutex>
+#include <string_view>
+
+// 分片个数的位数，编号的低位是分片号
+const size_t SYMBOL_SHARD_BITS = 6;
+
+const size_t SYMBOL_SHARDS = size_t(1) << SYMBOL_SHARD_BITS;
+
+/**
+   多个线程共用的符号表，同一个拼写在所有文件中得到同一个编号
+   按哈希分成 SYMBOL_SHARDS 个分片，每片是一个 SymbolTable 加读写锁，
+   已有的拼写只加读锁；编号是分片内编号左移后加上分片号，不连续
+   Lex 会先在自己的符号表中查找，每个文件的每个拼写只访问这里一次
+ */
+class SharedSymbolTable {
+public:
+  SharedSymbolTable();
+
+  SharedSymbolTable(const SharedSymbolTable &) = delete;
+  SharedSymbolTable &operator=(const SharedSymbolTable &) = delete;
+
+  Symbol intern(std::string_view text);
+
+  /**
+     只查找不插入，没有时返回 NO_SYMBOL
+   */
+  Symbol find(std::string_view text) const;
+
+  /**
+     拼写在符号表析构前一直有效
+   */
+  std::string_view spelling(Symbol symbol) const;
+
+  /**
+     不同标识符的个数
+   */
+  size_t size() const;
+
+  size_t memory() const;
+
+private:
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    SymbolTable table;
+  };
+
+  Shard shards[SYMBOL_SHARDS];
+
+  static size_t shard_of(std::string_view text);
+};
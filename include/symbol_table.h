@@ -0,0 +1,70 @@
+#pragma once
+#include "arena.h"
+#include "type.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 默认的初始槽数
+const size_t SYMBOL_TABLE_SIZE = 1024;
+
+/**
+   标识符的符号表
+   相同拼写总是得到同一个编号，编号从 0 开始连续分配，拼写拷贝进自己的 Arena，
+   在符号表析构前一直有效
+   开放寻址、线性探测，装载因子超过一半时扩容
+ */
+class SymbolTable {
+public:
+  /**
+     capacity 是初始槽数，向上取到 2 的幂
+   */
+  SymbolTable(size_t capacity = SYMBOL_TABLE_SIZE);
+
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  /**
+     返回 text 的编号，第一次出现时分配新的编号，并把出现次数加一
+   */
+  Symbol intern(std::string_view text);
+
+  /**
+     只查找不插入，没有时返回 NO_SYMBOL
+   */
+  Symbol find(std::string_view text) const;
+
+  std::string_view spelling(Symbol symbol) const;
+
+  /**
+     intern 的次数，即标识符在输入中出现的次数
+   */
+  size_t count(Symbol symbol) const;
+
+  /**
+     不同标识符的个数
+   */
+  size_t size() const;
+
+  /**
+     槽、拼写和计数占用的字节数
+   */
+  size_t memory() const;
+
+private:
+  struct Slot {
+    uint32_t hash;
+    Symbol symbol;
+  };
+
+  std::vector<Slot> slots;
+  std::vector<std::string_view> spellings;
+  std::vector<size_t> counts;
+  Arena arena;
+
+  // text 所在的槽，没有时为应当插入的空槽
+  size_t probe(std::string_view text, uint32_t hash) const;
+
+  void grow();
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "token_file.h"
+#include "token_stream.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+const uint64_t TOKEN_CACHE_SIZE = uint64_t(256) << 20;
+
+/**
+   按输入内容的哈希缓存 Token 序列的目录
+   文件名由 XXH64、输入长度、分词器版本和文件格式版本组成，内容相同的输入
+   总是落到同一个文件；写入先写临时文件再改名，多个进程同时写也不会读到半个文件
+   总大小超过上限时按修改时间淘汰最久没用过的文件，命中时会更新修改时间
+ */
+class TokenCache {
+public:
+  TokenCache(std::string dir, uint64_t max_bytes = TOKEN_CACHE_SIZE);
+
+  /**
+     source 对应的缓存文件的路径，要对整个输入做一次哈希
+     查找没有命中时把同一个 key 交给 store，不再重复计算
+   */
+  std::string key(std::string_view source) const;
+
+  /**
+     查找 source 对应的缓存，key 由 key(source) 得到，没有时返回 nullptr
+   */
+  std::unique_ptr<TokenFile> find(std::string_view source,
+                                  const std::string &key);
+
+  /**
+     保存解析结果，不保存单词内容，命中时从输入中取
+     目录不可写、磁盘已满或输入超过 4 GiB 时只输出警告，不抛出异常
+   */
+  void store(const std::string &key, const TokenStream &tokens,
+             const DiagnosticBuffer *diagnostics = nullptr);
+
+  size_t hits() const;
+
+  size_t misses() const;
+
+private:
+  std::string dir;
+  uint64_t max_bytes;
+
+  // 目录的大致大小，超过上限时重新扫描并淘汰
+  std::atomic<uint64_t> bytes;
+  std::atomic<size_t> _hits;
+  std::atomic<size_t> _misses;
+  std::atomic<size_t> serial;
+
+  void evict();
+};
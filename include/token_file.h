@@ -0,0 +1,181 @@
+#pragma once
+#include "diagnostic.h"
+#include "reader.h"
+#include "token_stream.h"
+#include "type.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+
+const uint32_t TOKEN_FILE_VERSION = 2;
+
+// 每隔这么多个 Token 记录一次偏移的解码状态，随机访问最多解码这么多个变长整数
+const size_t TOKEN_FILE_CHECKPOINT = 64;
+
+/**
+   Token 序列的二进制文件，按主机字节序（小端）存储
+   头部之后依次是（每段按 8 字节对齐）：
+     类型列 u8、运算符/保留字列 u8、长度列 u32、换行偏移 u32、检查点、
+     偏移列（和上一个 Token 结尾之差的 LEB128 变长整数）、可选的单词内容表、诊断
+   读取时把整个文件 mmap 进来，各列直接指向映射的内存
+ */
+class TokenFile {
+public:
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t diagnostics;
+    uint64_t count;
+    uint64_t lines;
+    uint64_t offsets_size;
+    uint64_t text_size;
+    // 超过上限没有保存的诊断条数
+    uint64_t dropped;
+  };
+
+  // 单词内容表存在
+  static const uint32_t HAS_TEXT = 1;
+
+  struct Checkpoint {
+    // 第 k * TOKEN_FILE_CHECKPOINT 个 Token 的偏移
+    uint32_t offset;
+    // 它之后的下一个变长整数在偏移列中的位置
+    uint32_t pos;
+    // 它的单词内容在内容表中的位置
+    uint32_t text;
+  };
+
+  // 诊断只存位置，单词内容从输入中取
+  struct DiagnosticRecord {
+    uint32_t kind;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t count;
+  };
+
+  /**
+     顺序访问时逐个解码偏移，不需要回到检查点
+   */
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Token;
+
+    iterator(const TokenFile *file, size_t index);
+
+    Token operator*() const;
+
+    iterator &operator++();
+
+    bool operator==(const iterator &other) const {
+      return this->index == other.index;
+    }
+    bool operator!=(const iterator &other) const {
+      return this->index != other.index;
+    }
+
+  private:
+    const TokenFile *file;
+    size_t index;
+    size_t offset;
+    size_t pos;
+    size_t text;
+  };
+
+  /**
+     把 tokens 写到 path，with_text 为 false 时不保存单词内容
+     diagnostics 不为空时一起保存解析时的诊断
+   */
+  static void write(const char *path, const TokenStream &tokens,
+                    bool with_text = true,
+                    const DiagnosticBuffer *diagnostics = nullptr);
+
+  /**
+     打开时检查整个文件：变长整数不越界，类型和运算符/保留字编号合法，
+     检查点和换行偏移一致，每个 Token 的结尾不超过 source_size（未知时只检查不溢出）
+     文件损坏时抛出异常
+   */
+  TokenFile(const char *path,
+            size_t source_size = std::numeric_limits<size_t>::max());
+
+  /**
+     把所有 Token 追加到 tokens，tokens 必须读同一段连续输入
+   */
+  void load(TokenStream &tokens) const;
+
+  /**
+     把保存的诊断追加到 diagnostics，单词内容指向 source，source 是写入时的输入
+   */
+  void load_diagnostics(DiagnosticBuffer &diagnostics,
+                        std::string_view source) const;
+
+  ~TokenFile();
+
+  TokenFile(const TokenFile &) = delete;
+  TokenFile &operator=(const TokenFile &) = delete;
+
+  size_t size() const;
+
+  bool empty() const;
+
+  bool has_text() const;
+
+  /**
+     还原第 i 个 Token
+     没有单词内容表时标识符等 Token 的内容为空
+   */
+  Token operator[](size_t i) const;
+
+  iterator begin() const;
+
+  iterator end() const;
+
+  Token::TokenType type(size_t i) const;
+
+  uint8_t subtype(size_t i) const;
+
+  uint32_t offset(size_t i) const;
+
+  uint32_t length(size_t i) const;
+
+  std::string_view text(size_t i) const;
+
+  Position position(size_t i) const;
+
+private:
+  const char *data_;
+  size_t size_;
+
+  // mmap 得到的映射，不支持 mmap 时把文件读进 buffer_
+  void *mapping_;
+  std::string buffer_;
+
+  const Header *header;
+  const uint8_t *kinds;
+  const uint8_t *subtypes;
+  const uint32_t *lengths;
+  const uint32_t *lines;
+  const Checkpoint *checkpoints;
+  const uint8_t *offsets;
+  const char *texts;
+  const DiagnosticRecord *diagnostics;
+
+  // 映射或读入文件并定位各段
+  void map(const char *path);
+
+  void validate(size_t source_size) const;
+
+  // 第 i 个 Token 的偏移、下一个变长整数的位置以及它的单词内容在内容表中的位置
+  void locate(size_t i, size_t &offset, size_t &pos, size_t &text) const;
+
+  Position position_at(size_t offset) const;
+
+  Token make(size_t i, size_t offset, size_t text) const;
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include "reader.h"
+#include "type.h"
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+/**
+   按列存储的 Token 序列
+   每个 Token 只占 类型(1) + 运算符/保留字(1) + 偏移(4) + 长度(4) + 符号(4) 个字节，
+   单词内容和位置在访问时由输入和 Reader 的换行记录还原
+ */
+class TokenStream {
+public:
+  /**
+     解引用得到的是按列还原的 Token 值而不是引用，按标准只能算输入迭代器；
+     下标、加减和比较仍然是常数时间
+   */
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Token;
+
+    iterator(const TokenStream *stream, size_t index)
+        : stream(stream), index(index) {}
+
+    Token operator*() const { return (*this->stream)[this->index]; }
+    Token operator[](difference_type n) const {
+      return (*this->stream)[this->index + n];
+    }
+
+    iterator &operator++() {
+      this->index++;
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator res = *this;
+      this->index++;
+      return res;
+    }
+    iterator &operator--() {
+      this->index--;
+      return *this;
+    }
+    iterator operator--(int) {
+      iterator res = *this;
+      this->index--;
+      return res;
+    }
+    iterator &operator+=(difference_type n) {
+      this->index += n;
+      return *this;
+    }
+    iterator &operator-=(difference_type n) {
+      this->index -= n;
+      return *this;
+    }
+    iterator operator+(difference_type n) const {
+      return iterator(this->stream, this->index + n);
+    }
+    iterator operator-(difference_type n) const {
+      return iterator(this->stream, this->index - n);
+    }
+    difference_type operator-(const iterator &other) const {
+      return (difference_type)this->index - (difference_type)other.index;
+    }
+
+    bool operator==(const iterator &other) const {
+      return this->index == other.index;
+    }
+    bool operator!=(const iterator &other) const {
+      return this->index != other.index;
+    }
+    bool operator<(const iterator &other) const {
+      return this->index < other.index;
+    }
+    bool operator>(const iterator &other) const {
+      return this->index > other.index;
+    }
+    bool operator<=(const iterator &other) const {
+      return this->index <= other.index;
+    }
+    bool operator>=(const iterator &other) const {
+      return this->index >= other.index;
+    }
+
+    friend iterator operator+(difference_type n, const iterator &it) {
+      return it + n;
+    }
+
+  private:
+    const TokenStream *stream;
+    size_t index;
+  };
+
+  /**
+     reader 提供输入内容和换行记录，必须比 TokenStream 活得久
+   */
+  TokenStream(const Reader *reader);
+
+  void push_back(const Token &token);
+
+  /**
+     直接追加各列的值，只用于连续输入
+     offset + length 超出 u32 时抛出异常
+   */
+  void push_back(Token::TokenType type, uint8_t subtype, uint32_t offset,
+                 uint32_t length, Symbol symbol = NO_SYMBOL);
+
+  /**
+     追加 other 中 [from, to) 的 Token，两者必须读同一段连续输入
+   */
+  void append(const TokenStream &other, size_t from, size_t to);
+
+  // 改写第 i 个 Token 的符号编号，用于来自其他符号表或没有编号的 Token
+  void set_symbol(size_t i, Symbol symbol);
+
+  size_t size() const;
+
+  bool empty() const;
+
+  void reserve(size_t n);
+
+  /**
+     还原第 i 个 Token
+   */
+  Token operator[](size_t i) const;
+
+  Token back() const;
+
+  iterator begin() const;
+
+  iterator end() const;
+
+  Token::TokenType type(size_t i) const;
+
+  // 运算符或保留字的枚举值，其余类型为 0
+  uint8_t subtype(size_t i) const;
+
+  uint32_t offset(size_t i) const;
+
+  uint32_t length(size_t i) const;
+
+  // 标识符的编号，其余类型为 NO_SYMBOL
+  Symbol symbol(size_t i) const;
+
+  // 第一个偏移不小于 offset 的 Token 的下标
+  size_t lower_bound(size_t offset) const;
+
+  std::string_view text(size_t i) const;
+
+  Position position(size_t i) const;
+
+  // 提供输入内容和换行记录的 Reader
+  const Reader &input() const;
+
+  /**
+     各列占用的字节数
+   */
+  size_t memory() const;
+
+private:
+  const Reader *reader;
+
+  std::vector<uint8_t> _kinds;
+  std::vector<uint8_t> _subtypes;
+  std::vector<uint32_t> _offsets;
+  std::vector<uint32_t> _lengths;
+  std::vector<Symbol> _symbols;
+
+  // 非连续输入时单词内容的地址，指向 Lex 的 Arena 或符号表，连续输入时为空
+  std::vector<const char *> _texts;
+};
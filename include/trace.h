@@ -0,0 +1,53 @@
+#pragma once
+#include "type.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+const size_t TRACE_BUFFER = 1 << 20;
+
+/**
+   逐个输出 Token 的跟踪
+   格式化的结果先攒在一块大缓冲里，写满后交给后台线程写出，
+   解析线程只在后台线程还没写完上一块时才会等待
+ */
+class TraceSink {
+public:
+  TraceSink(std::FILE *out, size_t buffer_size = TRACE_BUFFER);
+
+  // 写出剩余内容
+  ~TraceSink();
+
+  TraceSink(const TraceSink &) = delete;
+  TraceSink &operator=(const TraceSink &) = delete;
+
+  // 按 {:d} 格式追加一行，Token 需要带有位置
+  void write(const Token &token);
+
+  // 把已经追加的内容全部写出
+  void flush();
+
+private:
+  std::FILE *out;
+  size_t capacity;
+
+  // 正在追加的缓冲，只由解析线程访问
+  std::string current;
+
+  // 交给后台线程的缓冲，为空表示后台线程空闲
+  std::string pending;
+
+  std::mutex mutex;
+  std::condition_variable work_cv;
+  std::condition_variable idle_cv;
+  bool stopping;
+  std::thread writer;
+
+  // 等上一块写完后把 current 交给后台线程
+  void hand_off();
+
+  void run();
+};
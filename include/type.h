@@ -1,11 +1,13 @@
 #pragma once
 #include "reader.h"
+#include <cstdint>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <iostream>
 #include <plog/Initializers/RollingFileInitializer.h>
 #include <plog/Log.h>
 #include <string>
+#include <string_view>
 
 enum class OpType {
   ASSIGN,     // 赋值
@@ -78,6 +80,16 @@ enum class ReservedWordType {
   STRUCT,
 };
 
+const size_t OP_TYPE_COUNT = static_cast<size_t>(OpType::R_PAREN) + 1;
+
+const size_t RESERVED_WORD_COUNT =
+    static_cast<size_t>(ReservedWordType::STRUCT) + 1;
+
+// 标识符在符号表中的编号
+using Symbol = uint32_t;
+
+const Symbol NO_SYMBOL = UINT32_MAX;
+
 class Token {
 public:
   enum class TokenType {
@@ -91,9 +103,12 @@ public:
   };
 
   Token() {}
-  Token(OpType op_type, Position pos = Position{});
-  Token(ReservedWordType reserved_word, Position pos = Position{});
-  Token(Token::TokenType type, char *data = NULL, Position pos = Position{});
+  Token(OpType op_type, Position pos = Position{}, size_t offset = 0);
+  Token(ReservedWordType reserved_word, Position pos = Position{},
+        size_t offset = 0);
+  // text 不拷贝，指向输入或 Lex 持有的内存，生命周期与产生它的 Lex 相同
+  Token(Token::TokenType type, std::string_view text = std::string_view(),
+        Position pos = Position{}, size_t offset = 0);
 
   bool is_op() const;
   bool is_reserved_word() const;
@@ -105,15 +120,24 @@ public:
 
   OpType as_op() const;
   ReservedWordType as_reserved_word() const;
-  char *as_ident() const;
-  char *as_number() const;
-  char *as_string() const;
-  char *as_char() const;
+  std::string_view as_ident() const;
+  std::string_view as_number() const;
+  std::string_view as_string() const;
+  std::string_view as_char() const;
 
   TokenType type() const;
 
+  // 在输入中占用的字节数
+  size_t length() const;
+
   Position p_token;
 
+  // 在输入中的字节偏移
+  size_t offset;
+
+  // 标识符在产生它的 Lex 的符号表中的编号，其余类型为 NO_SYMBOL
+  Symbol symbol = NO_SYMBOL;
+
   inline bool operator==(const Token &other) const {
     if (this->is_op() && other.is_op()) {
       return this->as_op() == other.as_op();
@@ -138,7 +162,10 @@ private:
   union TokenValue {
     OpType op_type;
     ReservedWordType reserved_word;
-    char *data;
+    struct {
+      const char *data;
+      size_t size;
+    } text;
   };
 
   TokenType token_type;
@@ -146,6 +173,12 @@ private:
   TokenValue token_value;
 };
 
+// 运算符的写法，如 "+="
+std::string_view spelling(OpType op_type);
+
+// 保留字的写法
+std::string_view spelling(ReservedWordType reserved_word);
+
 namespace plog {
 Record &operator<<(Record &record, const OpType &o);
 Record &operator<<(Record &record, const ReservedWordType &r);
@@ -167,9 +200,12 @@ template <> struct fmt::formatter<OpType> : formatter<string_view> {
   template <typename FormatContext>
   auto format(const OpType &p, FormatContext &ctx) {
     string_view s = "unknown";
+    // 详细格式的内容放在 buf 里，保证 format 返回前一直有效
+    std::string buf;
 #define PROCESS_VAL(p, name, details)                                          \
   case (p):                                                                    \
-    s = is_details ? fmt::format("{} '{}'", details, name) : name;             \
+    s = is_details ? string_view(buf = fmt::format("{} '{}'", details, name))  \
+                   : string_view(name);                                        \
     break;
     switch (p) {
       PROCESS_VAL(OpType::ASSIGN, "=", "ASSIGN ");
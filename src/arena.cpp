@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+Arena::Arena(size_t slab_size)
+    : slab_size(slab_size), cursor(nullptr), limit(nullptr), used_(0),
+      reserved_(0) {}
+
+char *Arena::allocate(size_t size, size_t align) {
+  uintptr_t p = reinterpret_cast<uintptr_t>(this->cursor);
+  uintptr_t aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+  if (this->cursor == nullptr ||
+      aligned + size > reinterpret_cast<uintptr_t>(this->limit)) {
+    this->grow(size + align - 1);
+    p = reinterpret_cast<uintptr_t>(this->cursor);
+    aligned = (p + align - 1) & ~(uintptr_t)(align - 1);
+  }
+  char *res = reinterpret_cast<char *>(aligned);
+  this->cursor = res + size;
+  this->used_ += size;
+  return res;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+  if (text.empty()) {
+    return std::string_view();
+  }
+  char *p = this->allocate(text.size());
+  memcpy(p, text.data(), text.size());
+  return std::string_view(p, text.size());
+}
+
+void Arena::reset() {
+  if (this->slabs.size() > 1) {
+    this->slabs.erase(this->slabs.begin() + 1, this->slabs.end());
+  }
+  if (this->slabs.empty()) {
+    this->cursor = this->limit = nullptr;
+    this->reserved_ = 0;
+  } else {
+    this->cursor = this->slabs[0].data.get();
+    this->limit = this->cursor + this->slabs[0].size;
+    this->reserved_ = this->slabs[0].size;
+  }
+  this->used_ = 0;
+}
+
+size_t Arena::used() const { return this->used_; }
+
+size_t Arena::reserved() const { return this->reserved_; }
+
+void Arena::grow(size_t size) {
+  // 超过块大小的请求单独占一块
+  size_t n = std::max(size, this->slab_size);
+  this->slabs.push_back(Slab{std::unique_ptr<char[]>(new char[n]), n});
+  this->cursor = this->slabs.back().data.get();
+  this->limit = this->cursor + n;
+  this->reserved_ += n;
+}
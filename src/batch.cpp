@@ -0,0 +1,116 @@
+#include "batch.h"
+#include "lex.h"
+#include "pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <exception>
+#include <numeric>
+#include <plog/Log.h>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace batch {
+
+static bool is_source(const fs::path &path) {
+  std::string ext = path.extension().string();
+  return ext == ".c" || ext == ".h";
+}
+
+static void expand(const std::string &arg, std::vector<std::string> &files) {
+  if (!arg.empty() && arg[0] == '@') {
+    std::ifstream list(arg.substr(1));
+    if (!list) {
+      PLOGW << "can not open the response file " << arg.substr(1);
+      return;
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (!line.empty()) {
+        expand(line, files);
+      }
+    }
+    return;
+  }
+  std::error_code ec;
+  if (fs::is_directory(arg, ec)) {
+    for (fs::recursive_directory_iterator it(arg, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      if (it->is_regular_file(ec) && is_source(it->path())) {
+        files.push_back(it->path().string());
+      }
+    }
+    return;
+  }
+  if (!fs::exists(arg, ec)) {
+    PLOGW << "the file " << arg << " does not exist";
+    return;
+  }
+  files.push_back(arg);
+}
+
+std::vector<std::string> collect(const std::vector<std::string> &args) {
+  std::vector<std::string> files;
+  for (const auto &arg : args) {
+    expand(arg, files);
+  }
+  return files;
+}
+
+Result run(std::vector<std::string> files, size_t threads,
+           TokenCache *cache, SharedSymbolTable *symbols) {
+  Result res;
+  res.files = std::move(files);
+  res.stats.resize(res.files.size());
+  res.errors.resize(res.files.size());
+
+  // 大文件先调度，避免最后只剩一个大文件在单线程上跑
+  std::vector<uintmax_t> sizes(res.files.size());
+  for (size_t i = 0; i < res.files.size(); i++) {
+    std::error_code ec;
+    sizes[i] = fs::file_size(res.files[i], ec);
+    if (ec) {
+      sizes[i] = 0;
+    }
+  }
+  std::vector<size_t> order(res.files.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+  ThreadPool pool(threads);
+  for (size_t i : order) {
+    // 每个任务只写自己的那一项，不需要加锁
+    pool.submit([&res, i, cache, symbols] {
+      try {
+        Lex lex(res.files[i].c_str());
+        lex.set_cache(cache);
+        lex.set_symbols(symbols);
+        lex.parse();
+        lex.report_diagnostics();
+        res.stats[i] = lex.stats();
+      } catch (const char *e) {
+        res.errors[i] = e;
+      } catch (const std::exception &e) {
+        res.errors[i] = e.what();
+      }
+    });
+  }
+  pool.wait();
+
+  for (size_t i = 0; i < res.files.size(); i++) {
+    if (!res.errors[i].empty()) {
+      res.failed++;
+      continue;
+    }
+    res.total.merge(res.stats[i]);
+  }
+  return res;
+}
+
+} // namespace batch
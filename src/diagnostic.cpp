@@ -0,0 +1,56 @@
+#include "diagnostic.h"
+#include <algorithm>
+
+std::string Diagnostic::message() const {
+  std::string text(this->text);
+  switch (this->kind) {
+  case Kind::BadNumber:
+    return "the number " + text + " is not correct";
+  case Kind::UnterminatedString:
+    return "the string " + text + " is not correct";
+  case Kind::UnterminatedChar:
+    return "the char " + text + " is not correct";
+  case Kind::BadCharLength:
+    return "the char " + text + " has not right length";
+  }
+  return text;
+}
+
+DiagnosticBuffer::DiagnosticBuffer(size_t limit, bool dedupe)
+    : limit(limit), dedupe(dedupe), _dropped(0),
+      arena(DIAGNOSTIC_RESERVE * 16) {
+  this->_items.reserve(std::min(limit, DIAGNOSTIC_RESERVE));
+}
+
+void DiagnosticBuffer::add(Diagnostic::Kind kind, size_t offset,
+                           std::string_view text, bool copy, size_t count) {
+  auto &seen = this->seen[static_cast<size_t>(kind)];
+  if (this->dedupe) {
+    auto it = seen.find(text);
+    if (it != seen.end()) {
+      this->_items[it->second].count += count;
+      return;
+    }
+  }
+  if (this->_items.size() >= this->limit) {
+    this->_dropped += count;
+    return;
+  }
+  if (copy) {
+    text = this->arena.copy(text);
+  }
+  if (this->dedupe) {
+    seen.emplace(text, this->_items.size());
+  }
+  this->_items.push_back(Diagnostic{kind, offset, text.size(), text, count});
+}
+
+const std::vector<Diagnostic> &DiagnosticBuffer::items() const {
+  return this->_items;
+}
+
+size_t DiagnosticBuffer::dropped() const { return this->_dropped; }
+
+void DiagnosticBuffer::set_limit(size_t limit) { this->limit = limit; }
+
+void DiagnosticBuffer::drop(size_t count) { this->_dropped += count; }
@@ -1,94 +1,255 @@
 #include "lex.h"
-#include <cctype>
+#include "keyword.h"
+#include "metrics.h"
+#include "number.h"
+#include "op.h"
+#include "scan.h"
+#include "token_cache.h"
+#include <algorithm>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <plog/Log.h>
 #include <regex>
 #include <string>
 
-Lex::Lex(const char *path) : reader(new Reader(path)) {}
+// 编译期的日志级别，由 clex.cmake 的 CLEX_TRACE_LEVEL 设置
+// 0 不输出日志，1 只输出警告，2 另外用 plog 逐个输出 Token
+#ifndef CLEX_TRACE_LEVEL
+#define CLEX_TRACE_LEVEL 1
+#endif
 
-static inline bool is_ident_byte(const char c) {
-  return std::isalnum(c) || c == '_';
+#if CLEX_TRACE_LEVEL >= 1
+#define CLEX_WARN(message) PLOGW << (message)
+#else
+#define CLEX_WARN(message) (void)(message)
+#endif
+
+#if CLEX_TRACE_LEVEL >= 2
+#define CLEX_TRACE(token) PLOGI << (token)
+#else
+#define CLEX_TRACE(token) (void)0
+#endif
+
+// 性能计数，由 clex.cmake 的 CLEX_METRICS 打开，关闭时不产生任何代码
+#ifndef CLEX_METRICS
+#define CLEX_METRICS 0
+#endif
+
+#if CLEX_METRICS
+#define CLEX_TIME(routine)                                                     \
+  metrics::ScopedTimer metrics_timer(metrics::Routine::routine)
+#define CLEX_TIME_DISCARD() metrics_timer.discard()
+#define CLEX_COUNT(token)                                                      \
+  metrics::record_token((token).type(),                                        \
+                        this->reader->offset() - (token).offset)
+#else
+#define CLEX_TIME(routine) (void)0
+#define CLEX_TIME_DISCARD() (void)0
+#define CLEX_COUNT(token) (void)0
+#endif
+
+Lex::Lex(const char *path)
+    : reader(new Reader(path)), _tokens(this->reader.get()),
+      trace_sink(nullptr), interning(true), shared_symbols(nullptr),
+      cache(nullptr), cache_hits(0), cache_misses(0) {}
+
+Lex::Lex(std::string_view source)
+    : reader(new Reader(source)), _tokens(this->reader.get()),
+      trace_sink(nullptr), interning(true), shared_symbols(nullptr),
+      cache(nullptr), cache_hits(0), cache_misses(0) {}
+
+// 分块和重新解析得到的 Token 和诊断由调用者筛选合并，这里不编号，
+// 诊断不去重也不设上限
+Lex::Lex(std::unique_ptr<Reader> reader)
+    : reader(std::move(reader)), _tokens(this->reader.get()),
+      trace_sink(nullptr), interning(false), shared_symbols(nullptr),
+      cache(nullptr), cache_hits(0), cache_misses(0),
+      _diagnostics(std::numeric_limits<size_t>::max(), false) {}
+
+Lex::iterator::iterator() : lex(nullptr) {}
+
+Lex::iterator::iterator(Lex *lex) : lex(lex) { ++(*this); }
+
+Lex::iterator &Lex::iterator::operator++() {
+  if (this->lex != nullptr && !this->lex->next(this->token)) {
+    this->lex = nullptr;
+  }
+  return *this;
 }
 
-static inline bool is_num_byte(const char c) {
-  return std::isalnum(c) || c == '_' || c == '.';
+Token Lex::make_op(OpType op) {
+  return Token(op, Position{}, this->reader->offset());
 }
 
-void Lex::parse_ident() {
-  size_t index = 0;
-  char *token = (char *)malloc(sizeof(char) * 50);
-  memset(token, 0, 50);
-  token[index++] = this->reader->peek();
-  while (is_ident_byte(this->reader->front_peek())) {
-    token[index++] = this->reader->front_peek();
-    this->reader->front_ahead();
+Token Lex::make_text(Token::TokenType type, std::string_view text) {
+  return Token(type, text, Position{}, this->reader->offset());
+}
+
+Token Lex::materialize(const Token &token, Arena &arena) {
+  switch (token.type()) {
+  case Token::TokenType::Number:
+    return Token(token.type(), arena.copy(token.as_number()), token.p_token,
+                 token.offset);
+  case Token::TokenType::String:
+    return Token(token.type(), arena.copy(token.as_string()), token.p_token,
+                 token.offset);
+  case Token::TokenType::Char:
+    return Token(token.type(), arena.copy(token.as_char()), token.p_token,
+                 token.offset);
+  default:
+    // 标识符的内容已经指向符号表
+    return token;
   }
-  auto res = reserved_word.find(token);
-  if (res != reserved_word.end()) {
-    this->_tokens.push_back(Token(res.value(), this->reader->pos()));
+}
+
+void Lex::diagnose(Diagnostic::Kind kind, std::string_view text) {
+  this->_diagnostics.add(kind, this->reader->offset(), text,
+                         !this->reader->is_contiguous());
+}
+
+Position Lex::position(const Token &token) const {
+  return this->reader->locate(token.offset);
+}
+
+Token Lex::parse_ident() {
+  CLEX_TIME(Ident);
+  this->reader->begin_lexeme();
+  if (this->reader->is_contiguous()) {
+    std::string_view src = this->reader->source();
+    size_t from = this->reader->offset() + 1;
+    this->reader->front_skip(
+        scan::ident_run(src.data() + from, src.size() - from));
   } else {
-    this->_tokens.push_back(
-        Token(Token::TokenType::Ident, token, this->reader->pos()));
+    while (scan::is_ident_byte(this->reader->front_peek())) {
+      this->reader->front_ahead();
+    }
+  }
+  std::string_view token = this->reader->end_lexeme();
+  auto res = keyword::find(token);
+  if (res) {
+    Token res_token(*res, Position{}, this->reader->offset());
+    this->reader->ahead();
+    return res_token;
   }
+  if (!this->interning) {
+    // 只有分块和重新解析的 Lex 不编号，它们总是读连续输入
+    Token res_token = this->make_text(Token::TokenType::Ident, token);
+    this->reader->ahead();
+    return res_token;
+  }
+  // 非连续输入时直接使用符号表里的拼写，不再另外拷贝
+  Symbol symbol = this->intern(token);
+  Token res_token = this->make_text(
+      Token::TokenType::Ident,
+      this->reader->is_contiguous()
+          ? token
+          : this->_symbols.spelling(this->_symbols.find(token)));
+  res_token.symbol = symbol;
   this->reader->ahead();
+  return res_token;
 }
 
-void Lex::parse_number() {
-  size_t index = 0;
-  char *token = (char *)malloc(sizeof(char) * 50);
-  memset(token, 0, 50);
-  token[index++] = this->reader->peek();
-  while (is_num_byte(this->reader->front_peek())) {
-    token[index++] = this->reader->front_peek();
-    this->reader->front_ahead();
-  }
-
-  //     "^(\-|\+)?"
-  //     "("
-  //     "0|"
-  //     "((\d*.\d+)|(\d+.\d*))(e(+|-)?\d+)?|"
-  //     "[1-9]\d*|"
-  //     "0[1-7][0-7]*|"
-  //     "0x[1-9a-f][0-9a-f]*|"
-  //     "0x([1-9a-f][0-9a-f]*.[0-9a-f]*|[0-9a-f]*.[1-9a-f][0-9a-f]*)p(+|-)?[0-9a-f]+"
-  //     ")"
-  //     "(ul|lu|l|u)?$"
+// 用原来的正则检查状态机的结果，由 clex.cmake 的 CLEX_NUMBER_ORACLE 打开
+// 正则很慢，不随 Debug 构建默认打开，以免影响 clex_bench 的结果
+#ifndef CLEX_NUMBER_ORACLE
+#define CLEX_NUMBER_ORACLE 0
+#endif
 
-  // ^(\-|\+)?(0|((\d*.\d+)|(\d+.\d*))(e(\+|\-)?\d+)?|[1-9]\d*|0[1-7][0-7]*|0x[1-9a-f][0-9a-f]*|0x([1-9a-f][0-9a-f]*.[0-9a-f]*|[0-9a-f]*.[1-9a-f][0-9a-f]*)p(\+|\-)?[0-9a-f]+)(ul|lu|l|u)?$
-
-  std::regex re(
+#if CLEX_NUMBER_ORACLE
+static bool number_oracle(std::string_view token) {
+  static const std::regex re(
       "^(\\-|\\+)?(0|(((\\d*\\.\\d+)|(\\d+\\.\\d*))(e(\\+|\\-)?\\d+)?)|([1-9]"
       "\\d*)|(0[1-"
       "7][0-7]*)|(0x[1-9a-f][0-9a-f]*)|(0x([1-9a-f][0-9a-f]*\\.[0-9a-f]*|["
       "0-9a-f]*\\.[1-9a-f][0-9a-f]*)p(\\+|\\-)?[0-9a-f]+))(ul|lu|l|u)?$");
-  if (!std::regex_match(token, re)) {
-    PLOGW << "the number " << token << " is not correct";
+  return std::regex_match(token.begin(), token.end(), re);
+}
+#endif
+
+Token Lex::parse_number() {
+  CLEX_TIME(Number);
+  this->reader->begin_lexeme();
+  bool valid;
+  std::string_view token;
+  if (this->reader->is_contiguous()) {
+    std::string_view src = this->reader->source();
+    size_t from = this->reader->offset() + 1;
+    this->reader->front_skip(
+        scan::number_run(src.data() + from, src.size() - from));
+    token = this->reader->end_lexeme();
+    valid = number::is_valid(token);
+  } else {
+    number::State state = number::step(number::START, this->reader->peek());
+    while (scan::is_number_byte(this->reader->front_peek())) {
+      state = number::step(state, this->reader->front_peek());
+      this->reader->front_ahead();
+    }
+    token = this->reader->end_lexeme();
+    valid = number::accept(state);
+  }
+#if CLEX_NUMBER_ORACLE
+  assert(valid == number_oracle(token));
+#endif
+  if (!valid) {
+    this->diagnose(Diagnostic::Kind::BadNumber, token);
   }
-  this->_tokens.push_back(
-      Token(Token::TokenType::Number, token, this->reader->pos()));
+  Token res = this->make_text(Token::TokenType::Number, token);
   this->reader->ahead();
-  return;
+  return res;
 }
 
 void Lex::parse_macro_or_line_comment() {
-  while (this->reader->front_peek() != '\n') {
+  CLEX_TIME(LineComment);
+  if (this->reader->is_contiguous()) {
+    std::string_view src = this->reader->source();
+    size_t from = std::min(this->reader->offset() + 1, src.size());
+    size_t end =
+        from + scan::find_line_end(src.data() + from, src.size() - from);
+    this->reader->front_skip(end - from);
+    this->reader->ahead();
+    return;
+  }
+  // 行尾的反斜杠表示续行，#define 可以跨越多行
+  char prev = this->reader->peek();
+  char prev2 = '\0';
+  while (!this->reader->is_front_eof()) {
+    char c = this->reader->front_peek();
+    if (c == '\n' && prev != '\\' && !(prev == '\r' && prev2 == '\\')) {
+      break;
+    }
+    prev2 = prev;
+    prev = c;
     this->reader->front_ahead();
   }
   this->reader->ahead();
 }
 
 void Lex::parse_block_comment() {
+  CLEX_TIME(BlockComment);
+  if (this->reader->is_contiguous()) {
+    // 从开头的 "/*" 之后开始找，"/*/" 不是完整的注释
+    std::string_view src = this->reader->source();
+    size_t from = std::min(this->reader->offset() + 2, src.size());
+    size_t end = from + scan::find_comment_end(src.data() + from,
+                                               src.size() - from);
+    end = std::min(end + 2, src.size());
+    this->reader->front_skip(end - (this->reader->offset() + 1));
+    this->reader->ahead();
+    return;
+  }
+  this->reader->front_ahead();
   int stat = 0;
-  while (stat != 2) {
+  while (stat != 2 && !this->reader->is_front_eof()) {
     if (stat == 0 && this->reader->front_peek() == '*') {
       stat = 1;
     } else if (stat == 1 && this->reader->front_peek() == '/') {
       stat = 2;
-    } else if (stat == 1) {
+    } else if (stat == 1 && this->reader->front_peek() != '*') {
       stat = 0;
     }
     this->reader->front_ahead();
@@ -96,16 +257,15 @@ void Lex::parse_block_comment() {
   this->reader->ahead();
 }
 
-void Lex::parse_string() {
-  size_t index = 0;
-  char *token = (char *)malloc(sizeof(char) * 50);
-  memset(token, 0, 50);
-  token[index++] = this->reader->peek();
+Token Lex::parse_string() {
+  CLEX_TIME(String);
+  this->reader->begin_lexeme();
   int stat = 0;
   while (stat != 2) {
-    if (this->reader->front_peek() == '\n') {
-      PLOGW << "the string " << token << " is not correct";
-      this->reader->front_ahead();
+    // 没有结束的引号时到行尾或输入结尾为止
+    if (this->reader->front_peek() == '\n' || this->reader->is_front_eof()) {
+      this->diagnose(Diagnostic::Kind::UnterminatedString,
+                     this->reader->end_lexeme());
       break;
     }
     if (stat == 0 && this->reader->front_peek() == '\\') {
@@ -115,23 +275,20 @@ void Lex::parse_string() {
     } else {
       stat = 0;
     }
-    token[index++] = this->reader->front_peek();
     this->reader->front_ahead();
   }
-  this->_tokens.push_back(
-      Token(Token::TokenType::String, token, this->reader->pos()));
+  std::string_view token = this->reader->end_lexeme();
+  Token res = this->make_text(Token::TokenType::String, token);
   this->reader->ahead();
+  return res;
 }
 
-void Lex::parse_char() {
-  size_t index = 0;
-  char *token = (char *)malloc(sizeof(char) * 50);
-  memset(token, 0, 50);
-  token[index++] = this->reader->peek();
+Token Lex::parse_char() {
+  CLEX_TIME(Char);
+  this->reader->begin_lexeme();
   int stat = 0;
   while (stat != 2) {
-    if (this->reader->front_peek() == '\n') {
-      PLOGW << "the char" << token << " is not correct";
+    if (this->reader->front_peek() == '\n' || this->reader->is_front_eof()) {
       break;
     }
     if (stat == 0 && this->reader->front_peek() == '\\') {
@@ -141,73 +298,64 @@ void Lex::parse_char() {
     } else {
       stat = 0;
     }
-    token[index++] = this->reader->front_peek();
     this->reader->front_ahead();
   }
-  if (!(std::strlen(token) == 4 && token[1] == '\\') &&
-      std::strlen(token) != 3) {
-    PLOGW << "the char" << token << " has not right length";
+  std::string_view token = this->reader->end_lexeme();
+  if (stat != 2) {
+    this->diagnose(Diagnostic::Kind::UnterminatedChar, token);
+  } else if (!(token.size() == 4 && token[1] == '\\') && token.size() != 3) {
+    this->diagnose(Diagnostic::Kind::BadCharLength, token);
   }
-  this->_tokens.push_back(
-      Token(Token::TokenType::Char, token, this->reader->pos()));
+  Token res = this->make_text(Token::TokenType::Char, token);
   this->reader->ahead();
+  return res;
 }
 
-void Lex::parse() {
-  while (true) {
-    if (this->reader->peek() == '\0' && this->reader->is_eof()) {
-      return;
-    }
-    switch (this->reader->peek()) {
-    case '+': {
-      if (this->reader->front_peek() == '+') {
-        this->_tokens.push_back(Token(OpType::INC, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::ADD_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::ADD, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '=': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::EQUAL, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::ASSIGN, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '-': {
-      if (this->reader->front_peek() == '-') {
-        this->_tokens.push_back(Token(OpType::DEC, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '>') {
-        this->_tokens.push_back(Token(OpType::ARROW, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::SUB_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::SUB, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
+bool Lex::parse_op(Token &token) {
+  // 标识符和数字之前都会先试一次运算符，只统计匹配到的调用
+  CLEX_TIME(Op);
+  if (this->reader->is_contiguous()) {
+    std::string_view src = this->reader->source();
+    size_t at = this->reader->offset();
+    const op::Candidate *c = op::match(
+        op::pack(src.data() + at, std::min(op::MAX_LEN, src.size() - at)));
+    if (c == nullptr) {
+      CLEX_TIME_DISCARD();
+      return false;
+    }
+    token = this->make_op(c->type);
+    this->reader->front_skip(c->len - 1);
+    this->reader->ahead();
+    return true;
+  }
+  // 非连续模式下只能看到两个字节，第三个字节要前进一位之后才能看到
+  char bytes[op::MAX_LEN] = {this->reader->peek(), this->reader->front_peek()};
+  const op::Candidate *c = op::match(op::pack(bytes, 2), 2);
+  if (c == nullptr) {
+    CLEX_TIME_DISCARD();
+    return false;
+  }
+  token = this->make_op(c->type);
+  if (c->len == 2) {
+    this->reader->front_ahead();
+    bytes[2] = this->reader->front_peek();
+    const op::Candidate *longer = op::match(op::pack(bytes, 3));
+    if (longer->len == 3) {
+      token = this->make_op(longer->type);
+      this->reader->front_ahead();
     }
-    case '*': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::MUL_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::ASTERISK, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
+  }
+  this->reader->ahead();
+  return true;
+}
+
+bool Lex::next(Token &token) {
+  while (true) {
+    char c = this->reader->peek();
+    if (c == '\0' && this->reader->is_eof()) {
+      return false;
     }
+    switch (c) {
     case '/': {
       if (this->reader->front_peek() == '/') {
         this->parse_macro_or_line_comment();
@@ -215,267 +363,373 @@ void Lex::parse() {
       } else if (this->reader->front_peek() == '*') {
         this->parse_block_comment();
         continue;
-      } else if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::DIV_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-        this->reader->ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::DIV, this->reader->pos()));
-        this->reader->ahead();
-      }
-      break;
-    }
-    case '%': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::MOD_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::MOD, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '&': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(
-            Token(OpType::BITWISE_AND_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '&') {
-        this->reader->front_ahead();
-        if (this->reader->front_peek() == '=') {
-          this->reader->front_ahead();
-          this->_tokens.push_back(
-              Token(OpType::AND_ASSIGN, this->reader->pos()));
-        } else {
-          this->_tokens.push_back(Token(OpType::AND, this->reader->pos()));
-        }
-      } else {
-        this->_tokens.push_back(Token(OpType::AMPERSAND, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '|': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(
-            Token(OpType::BITWISE_OR_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '|') {
-        this->reader->front_ahead();
-        if (this->reader->front_peek() == '=') {
-          this->reader->front_ahead();
-          this->_tokens.push_back(
-              Token(OpType::OR_ASSIGN, this->reader->pos()));
-        } else {
-          this->_tokens.push_back(Token(OpType::OR, this->reader->pos()));
-        }
-      } else {
-        this->_tokens.push_back(Token(OpType::BITWISE_OR, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '^': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(
-            Token(OpType::BITWISE_XOR_ASSIGN, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(
-            Token(OpType::BITWISE_XOR, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '~': {
-      this->_tokens.push_back(Token(OpType::BITWISE_NOT, this->reader->pos()));
-      this->reader->ahead();
-      break;
-    }
-    case '!': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::INEQUAL, this->reader->pos()));
-        this->reader->front_ahead();
-      } else {
-        this->_tokens.push_back(Token(OpType::NOT, this->reader->pos()));
       }
-      this->reader->ahead();
-      break;
-    }
-    case '<': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(Token(OpType::LESS_EQUAL, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '<') {
-        this->reader->front_ahead();
-        if (this->reader->front_peek() == '=') {
-          this->reader->front_ahead();
-          this->_tokens.push_back(
-              Token(OpType::SHL_ASSIGN, this->reader->pos()));
-        } else {
-          this->_tokens.push_back(Token(OpType::SHL, this->reader->pos()));
-        }
-      } else {
-        this->_tokens.push_back(Token(OpType::LESS, this->reader->pos()));
-      }
-      this->reader->ahead();
-      break;
-    }
-    case '>': {
-      if (this->reader->front_peek() == '=') {
-        this->_tokens.push_back(
-            Token(OpType::GREATER_EQUAL, this->reader->pos()));
-        this->reader->front_ahead();
-      } else if (this->reader->front_peek() == '<') {
-        this->reader->front_ahead();
-        if (this->reader->front_peek() == '=') {
-          this->reader->front_ahead();
-          this->_tokens.push_back(
-              Token(OpType::SHR_ASSIGN, this->reader->pos()));
-        } else {
-          this->_tokens.push_back(Token(OpType::SHR, this->reader->pos()));
-        }
-      } else {
-        this->_tokens.push_back(Token(OpType::GREATER, this->reader->pos()));
-      }
-      this->reader->ahead();
       break;
     }
     case '#': {
       this->parse_macro_or_line_comment();
       continue;
     }
-    case '?': {
-      this->_tokens.push_back(Token(OpType::QUESTION, this->reader->pos()));
-      this->reader->ahead();
-      break;
-    }
-    case ',': {
-      this->_tokens.push_back(Token(OpType::COMMA, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    case '\'': {
+      token = this->parse_char();
+      this->count(token);
+      return true;
     }
-    case ':': {
-      this->_tokens.push_back(Token(OpType::COLON, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    case '"': {
+      token = this->parse_string();
+      this->count(token);
+      return true;
     }
-    case ';': {
-      this->_tokens.push_back(Token(OpType::SEMICOLON, this->reader->pos()));
-      this->reader->ahead();
+    default:
       break;
     }
-    case '.': {
-      this->_tokens.push_back(Token(OpType::DOT, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    if (this->parse_op(token)) {
+      this->count(token);
+      return true;
     }
-    case '{': {
-      this->_tokens.push_back(Token(OpType::L_BRACE, this->reader->pos()));
+    if (c >= '0' && c <= '9') {
+      token = this->parse_number();
+    } else if (scan::is_ident_byte(c)) {
+      token = this->parse_ident();
+    } else {
       this->reader->ahead();
-      break;
+      continue;
     }
-    case '}': {
-      this->_tokens.push_back(Token(OpType::R_BRACE, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    this->count(token);
+    return true;
+  }
+}
+
+Symbol Lex::intern(std::string_view text) {
+  Symbol local = this->_symbols.intern(text);
+  if (this->shared_symbols == nullptr) {
+    return local;
+  }
+  // 本文件的编号连续分配，新的拼写正好是映射的下一项
+  if (local == this->shared_ids.size()) {
+    this->shared_ids.push_back(this->shared_symbols->intern(text));
+  }
+  return this->shared_ids[local];
+}
+
+void Lex::intern_from(size_t from) {
+  for (size_t i = from; i < this->_tokens.size(); i++) {
+    if (this->_tokens.type(i) == Token::TokenType::Ident) {
+      this->_tokens.set_symbol(i, this->intern(this->_tokens.text(i)));
     }
-    case '[': {
-      this->_tokens.push_back(Token(OpType::L_SQUARE, this->reader->pos()));
-      this->reader->ahead();
-      break;
+  }
+}
+
+void Lex::count(const Token &token) {
+  this->_stats.add(token);
+  CLEX_COUNT(token);
+}
+
+void Lex::count_from(size_t from) {
+  for (size_t i = from; i < this->_tokens.size(); i++) {
+    this->_stats.add(this->_tokens.type(i), this->_tokens.subtype(i));
+  }
+}
+
+size_t Lex::next_n(Token *tokens, size_t n) {
+  // 非连续输入时这一批的单词内容放在 batch 里，下一次调用前有效
+  this->batch.reset();
+  size_t i = 0;
+  while (i < n && this->next(tokens[i])) {
+    if (!this->reader->is_contiguous()) {
+      tokens[i] = this->materialize(tokens[i], this->batch);
+    }
+    i++;
+  }
+  return i;
+}
+
+void Lex::parse() {
+  // 缓存按整个输入的内容查找，只能用于从头开始的连续输入
+  bool cacheable = this->cache != nullptr && this->reader->is_contiguous() &&
+                   this->reader->offset() == 0 && this->_tokens.empty();
+  std::string key;
+  if (cacheable) {
+    std::string_view src = this->reader->source();
+    key = this->cache->key(src);
+    std::unique_ptr<TokenFile> file = this->cache->find(src, key);
+    if (file != nullptr) {
+      this->cache_hits++;
+      file->load(this->_tokens);
+      file->load_diagnostics(this->_diagnostics, src);
+      this->intern_from(0);
+      this->count_from(0);
+      this->reader->seek(src.size());
+      for (size_t i = 0; i < this->_tokens.size(); i++) {
+        CLEX_TRACE(this->_tokens[i]);
+        if (this->trace_sink != nullptr) {
+          this->trace_sink->write(this->_tokens[i]);
+        }
+      }
+      return;
     }
-    case ']': {
-      this->_tokens.push_back(Token(OpType::R_SQUARE, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    this->cache_misses++;
+  }
+
+  Token token;
+  while (this->next(token)) {
+    if (!this->reader->is_contiguous()) {
+      token = this->materialize(token, this->arena);
     }
-    case '(': {
-      this->_tokens.push_back(Token(OpType::L_PAREN, this->reader->pos()));
-      this->reader->ahead();
-      break;
+    this->_tokens.push_back(token);
+    CLEX_TRACE(this->_tokens.back());
+    if (this->trace_sink != nullptr) {
+      this->trace_sink->write(this->_tokens.back());
     }
-    case ')': {
-      this->_tokens.push_back(Token(OpType::R_PAREN, this->reader->pos()));
-      this->reader->ahead();
-      break;
+  }
+  if (cacheable) {
+    this->cache->store(key, this->_tokens, &this->_diagnostics);
+  }
+}
+
+void Lex::set_trace(TraceSink *sink) { this->trace_sink = sink; }
+
+void Lex::set_cache(TokenCache *cache) { this->cache = cache; }
+
+size_t Lex::parse_until(size_t end) {
+  Token token;
+  while (this->next(token)) {
+    if (token.offset >= end) {
+      return token.offset;
     }
-    case '\'': {
-      this->parse_char();
-      break;
+    this->_tokens.push_back(token);
+  }
+  return this->reader->source().size();
+}
+
+void Lex::parse_parallel(size_t threads) {
+  if (!this->reader->is_contiguous()) {
+    this->parse();
+    return;
+  }
+  std::string_view src = this->reader->source();
+  size_t begin = this->reader->offset();
+  threads = std::min(threads, (src.size() - begin) / PARALLEL_MIN_CHUNK);
+  if (threads <= 1) {
+    this->parse();
+    return;
+  }
+
+  // 切点放在换行之后，多数情况下正好是一个 Token 的起点，推测结果可以直接采用
+  std::vector<size_t> bounds(threads + 1);
+  bounds[0] = begin;
+  bounds[threads] = src.size();
+  for (size_t i = 1; i < threads; i++) {
+    size_t at = std::max(begin + (src.size() - begin) / threads * i,
+                         bounds[i - 1]);
+    const void *nl = memchr(src.data() + at, '\n', src.size() - at);
+    bounds[i] =
+        nl != nullptr ? static_cast<const char *>(nl) - src.data() + 1
+                      : src.size();
+  }
+
+  std::vector<std::unique_ptr<Lex>> chunks(threads);
+  std::vector<size_t> exits(threads);
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    chunks[i].reset(
+        new Lex(std::unique_ptr<Reader>(new Reader(src, bounds[i]))));
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([&, i] {
+      try {
+        exits[i] = chunks[i]->parse_until(bounds[i + 1]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
     }
-    case '"': {
-      this->parse_string();
-      break;
+  }
+
+  // cursor 是顺序解析到达的位置，每块从 cursor 开始和推测结果对齐
+  size_t first = this->_tokens.size();
+  size_t cursor = begin;
+  Token token;
+  for (size_t i = 0; i < threads; i++) {
+    if (cursor >= exits[i]) {
+      // 上一块的最后一个 Token 已经越过了这一块
+      continue;
     }
-    default: {
-      if (std::isdigit(this->reader->peek())) {
-        this->parse_number();
-      } else if (is_ident_byte(this->reader->peek())) {
-        this->parse_ident();
-      } else {
-        this->reader->ahead();
+    const TokenStream &spec = chunks[i]->_tokens;
+    size_t k = spec.lower_bound(cursor);
+    if (k == spec.size() || spec.offset(k) != cursor) {
+      Lex relex(std::unique_ptr<Reader>(new Reader(src, cursor)));
+      cursor = src.size();
+      while (relex.next(token)) {
+        if (token.offset >= bounds[i + 1]) {
+          cursor = token.offset;
+          break;
+        }
+        while (k < spec.size() && spec.offset(k) < token.offset) {
+          k++;
+        }
+        if (k < spec.size() && spec.offset(k) == token.offset) {
+          cursor = token.offset;
+          break;
+        }
+        this->_tokens.push_back(token);
+      }
+      for (const Diagnostic &d : relex.diagnostics()) {
+        if (d.offset < cursor) {
+          this->_diagnostics.add(d.kind, d.offset, d.text, false);
+        }
+      }
+      if (k == spec.size() || spec.offset(k) != cursor) {
+        // 这一块里没有对齐，剩下的交给下一块
         continue;
       }
-      // spdlog::info("{}",
     }
+    // 两边在同一个偏移上开始一个 Token，之后的解析完全相同
+    this->_tokens.append(spec, k, spec.size());
+    for (const Diagnostic &d : chunks[i]->diagnostics()) {
+      if (d.offset >= cursor && d.offset < exits[i]) {
+        this->_diagnostics.add(d.kind, d.offset, d.text, false);
+      }
     }
-    PLOGI << this->_tokens[this->_tokens.size() - 1];
+    cursor = exits[i];
   }
-}
+  // 各块没有编号，合并之后统一编号
+  this->intern_from(first);
+  this->count_from(first);
+  this->reader->seek(src.size());
 
-void Lex::report() {
-  // for (auto it : this->tokens) {
-  //   PLOGI << it;
-  // }
-
-  Position pos = this->reader->pos();
-  PLOGI << "语句行数: " << pos.row;
-  PLOGI << "字符总数: " << this->reader->count();
-  size_t op = 0;
-  size_t reserved = 0;
-  size_t ident = 0;
-  size_t number = 0;
-  size_t string = 0;
-  size_t char_ = 0;
-  for (auto it : this->_tokens) {
-    switch (it.type()) {
-    case Token::TokenType::OP: {
-      op++;
-      break;
-    }
-    case Token::TokenType::ReservedWord: {
-      reserved++;
-      break;
-    }
-    case Token::TokenType::Ident: {
-      ident++;
-      break;
+  for (size_t i = first; i < this->_tokens.size(); i++) {
+    CLEX_TRACE(this->_tokens[i]);
+    if (this->trace_sink != nullptr) {
+      this->trace_sink->write(this->_tokens[i]);
     }
-    case Token::TokenType::Number: {
-      number++;
-      break;
-    }
-    case Token::TokenType::String: {
-      string++;
-      break;
-    }
-    case Token::TokenType::Char: {
-      char_++;
-      break;
+  }
+}
+
+TokenDiff Lex::relex(std::string_view source, const TokenStream &tokens,
+                     const Edit &edit) {
+  // Token 的长度由它后面的一个字节决定，结尾严格在修改之前的 Token 不受影响
+  size_t lo = 0;
+  size_t hi = tokens.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (size_t(tokens.offset(mid)) + tokens.length(mid) < edit.offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    case Token::TokenType::Null: {
-      break;
+  }
+  TokenDiff diff;
+  diff.first = lo;
+  diff.delta = static_cast<std::ptrdiff_t>(edit.inserted) -
+               static_cast<std::ptrdiff_t>(edit.removed);
+  size_t start =
+      lo == 0 ? 0 : size_t(tokens.offset(lo - 1)) + tokens.length(lo - 1);
+
+  Lex lex(std::unique_ptr<Reader>(new Reader(source, start)));
+  size_t edit_end = edit.offset + edit.inserted;
+  size_t k = lo;
+  bool synced = false;
+  Token token;
+  while (lex.next(token)) {
+    if (token.offset >= edit_end) {
+      // 修改之后的内容没有变化，两边在同一位置开始一个 Token 时状态也相同
+      size_t old = token.offset - edit.inserted + edit.removed;
+      while (k < tokens.size() && tokens.offset(k) < old) {
+        k++;
+      }
+      if (k < tokens.size() && tokens.offset(k) == old) {
+        synced = true;
+        break;
+      }
     }
+    diff.inserted.push_back(token);
+  }
+  if (!synced) {
+    k = tokens.size();
+  }
+  diff.removed = k - lo;
+  // 对齐的那个 Token 不属于差异，它的诊断在原来的结果中
+  for (const Diagnostic &d : lex.diagnostics()) {
+    if (!synced || d.offset < token.offset) {
+      diff.diagnostics.push_back(d);
     }
   }
-  PLOGI << "Token个数: " << this->_tokens.size();
-  PLOGI << "其中OP个数: " << op;
-  PLOGI << "其中RESERVED个数: " << reserved;
-  PLOGI << "其中IDENT个数: " << ident;
-  PLOGI << "其中NUMBER个数: " << number;
-  PLOGI << "其中STRING个数: " << string;
-  PLOGI << "其中CHAR个数: " << char_;
+  return diff;
+}
+
+Lex::iterator Lex::begin() { return iterator(this); }
+
+Lex::iterator Lex::end() { return iterator(); }
+
+LexStats Lex::scan() {
+  Token token;
+  while (this->next(token)) {
+  }
+  return this->stats();
+}
+
+LexStats Lex::stats() const {
+  LexStats res = this->_stats;
+  res.files = 1;
+  res.rows = this->reader->pos().row;
+  res.chars = this->reader->count();
+  res.cache_hits = this->cache_hits;
+  res.cache_misses = this->cache_misses;
+  return res;
+}
+
+void Lex::report() {
+  this->report_diagnostics();
+  this->stats().report();
+}
+
+const std::vector<Diagnostic> &Lex::diagnostics() const {
+  return this->_diagnostics.items();
+}
+
+size_t Lex::dropped_diagnostics() const { return this->_diagnostics.dropped(); }
+
+void Lex::set_diagnostic_limit(size_t limit) {
+  this->_diagnostics.set_limit(limit);
+}
+
+Position Lex::position(const Diagnostic &diagnostic) const {
+  return this->reader->locate(diagnostic.offset);
+}
+
+std::string Lex::format(const Diagnostic &diagnostic) const {
+  Position pos = this->position(diagnostic);
+  std::string res =
+      fmt::format("{}:{}: {}", pos.row, pos.col, diagnostic.message());
+  if (diagnostic.count > 1) {
+    res += fmt::format(" (共 {} 次)", diagnostic.count);
+  }
+  return res;
 }
 
-std::vector<Token> const &Lex::tokens() const { return this->_tokens; }
\ No newline at end of file
+void Lex::report_diagnostics() const {
+  for (const Diagnostic &diagnostic : this->diagnostics()) {
+    CLEX_WARN(this->format(diagnostic));
+  }
+  if (this->dropped_diagnostics() > 0) {
+    CLEX_WARN(fmt::format("另有 {} 条诊断超过上限未保存",
+                          this->dropped_diagnostics()));
+  }
+}
+
+TokenStream const &Lex::tokens() const { return this->_tokens; }
+
+const SymbolTable &Lex::symbols() const { return this->_symbols; }
+
+void Lex::set_symbols(SharedSymbolTable *shared) {
+  this->shared_symbols = shared;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "lex_stats.h"
+#include <cassert>
+#include <plog/Log.h>
+
+void LexStats::add(const Token &token) {
+  switch (token.type()) {
+  case Token::TokenType::OP:
+    this->add(token.type(), static_cast<uint8_t>(token.as_op()));
+    break;
+  case Token::TokenType::ReservedWord:
+    this->add(token.type(), static_cast<uint8_t>(token.as_reserved_word()));
+    break;
+  default:
+    this->add(token.type(), 0);
+    break;
+  }
+}
+
+void LexStats::add(Token::TokenType type, uint8_t subtype) {
+  this->tokens++;
+  switch (type) {
+  case Token::TokenType::OP: {
+    // 缓存文件中的编号在 TokenFile 打开时已经检查过
+    assert(subtype < OP_TYPE_COUNT);
+    this->op++;
+    this->ops[subtype]++;
+    break;
+  }
+  case Token::TokenType::ReservedWord: {
+    assert(subtype < RESERVED_WORD_COUNT);
+    this->reserved++;
+    this->reserved_words[subtype]++;
+    break;
+  }
+  case Token::TokenType::Ident: {
+    this->ident++;
+    break;
+  }
+  case Token::TokenType::Number: {
+    this->number++;
+    break;
+  }
+  case Token::TokenType::String: {
+    this->string++;
+    break;
+  }
+  case Token::TokenType::Char: {
+    this->char_++;
+    break;
+  }
+  case Token::TokenType::Null: {
+    break;
+  }
+  }
+}
+
+void LexStats::merge(const LexStats &other) {
+  this->files += other.files;
+  this->rows += other.rows;
+  this->chars += other.chars;
+  this->tokens += other.tokens;
+  this->op += other.op;
+  this->reserved += other.reserved;
+  this->ident += other.ident;
+  this->number += other.number;
+  this->string += other.string;
+  this->char_ += other.char_;
+  this->cache_hits += other.cache_hits;
+  this->cache_misses += other.cache_misses;
+  for (size_t i = 0; i < OP_TYPE_COUNT; i++) {
+    this->ops[i] += other.ops[i];
+  }
+  for (size_t i = 0; i < RESERVED_WORD_COUNT; i++) {
+    this->reserved_words[i] += other.reserved_words[i];
+  }
+}
+
+void LexStats::report() const {
+  if (this->files > 1) {
+    PLOGI << "文件个数: " << this->files;
+  }
+  PLOGI << "语句行数: " << this->rows;
+  PLOGI << "字符总数: " << this->chars;
+  PLOGI << "Token个数: " << this->tokens;
+  PLOGI << "其中OP个数: " << this->op;
+  PLOGI << "其中RESERVED个数: " << this->reserved;
+  PLOGI << "其中IDENT个数: " << this->ident;
+  PLOGI << "其中NUMBER个数: " << this->number;
+  PLOGI << "其中STRING个数: " << this->string;
+  PLOGI << "其中CHAR个数: " << this->char_;
+  if (this->cache_hits + this->cache_misses > 0) {
+    PLOGI << "缓存命中: " << this->cache_hits
+          << ", 未命中: " << this->cache_misses;
+  }
+}
@@ -0,0 +1,321 @@
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <fmt/format.h>
+#include <mutex>
+#include <plog/Log.h>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLEX_HAS_RUSAGE 1
+#include <sys/resource.h>
+#endif
+
+#ifndef CLEX_METRICS
+#define CLEX_METRICS 0
+#endif
+
+namespace metrics {
+
+namespace {
+
+// 只有所属线程会写，snapshot 从别的线程读，所以用 relaxed 的原子变量代替 fetch_add
+struct Counters {
+  std::atomic<uint64_t> calls[ROUTINE_COUNT] = {};
+  std::atomic<uint64_t> ns[ROUTINE_COUNT] = {};
+  std::atomic<uint64_t> tokens[KIND_COUNT] = {};
+  std::atomic<uint64_t> bytes[KIND_COUNT] = {};
+  std::atomic<uint64_t> lengths[KIND_COUNT][LENGTH_BUCKETS] = {};
+  std::atomic<uint64_t> refills{0};
+  std::atomic<uint64_t> longest{0};
+  std::atomic<int> longest_type{static_cast<int>(Token::TokenType::Null)};
+
+  static void add(std::atomic<uint64_t> &c, uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  void add_to(Metrics &res) const {
+    for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+      res.routines[i].calls += this->calls[i].load(std::memory_order_relaxed);
+      res.routines[i].ns += this->ns[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+      res.tokens[i] += this->tokens[i].load(std::memory_order_relaxed);
+      res.bytes[i] += this->bytes[i].load(std::memory_order_relaxed);
+      for (size_t j = 0; j < LENGTH_BUCKETS; j++) {
+        res.lengths[i][j] += this->lengths[i][j].load(std::memory_order_relaxed);
+      }
+    }
+    res.refills += this->refills.load(std::memory_order_relaxed);
+    uint64_t longest = this->longest.load(std::memory_order_relaxed);
+    if (longest > res.longest) {
+      res.longest = longest;
+      res.longest_type = static_cast<Token::TokenType>(
+          this->longest_type.load(std::memory_order_relaxed));
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+      this->calls[i].store(0, std::memory_order_relaxed);
+      this->ns[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+      this->tokens[i].store(0, std::memory_order_relaxed);
+      this->bytes[i].store(0, std::memory_order_relaxed);
+      for (size_t j = 0; j < LENGTH_BUCKETS; j++) {
+        this->lengths[i][j].store(0, std::memory_order_relaxed);
+      }
+    }
+    this->refills.store(0, std::memory_order_relaxed);
+    this->longest.store(0, std::memory_order_relaxed);
+    this->longest_type.store(static_cast<int>(Token::TokenType::Null),
+                             std::memory_order_relaxed);
+  }
+};
+
+// 存活线程的计数，以及已经退出的线程留下的总数
+struct Registry {
+  std::mutex mutex;
+  std::vector<Counters *> live;
+  Metrics retired;
+};
+
+// 线程可能在静态对象析构之后才退出，故意不释放
+Registry &registry() {
+  static Registry *res = new Registry();
+  return *res;
+}
+
+struct Local {
+  Counters counters;
+
+  Local() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.live.push_back(&this->counters);
+  }
+
+  ~Local() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    this->counters.add_to(r.retired);
+    r.live.erase(std::find(r.live.begin(), r.live.end(), &this->counters));
+  }
+};
+
+Counters &local() {
+  thread_local Local res;
+  return res.counters;
+}
+
+size_t bucket(size_t length) {
+  size_t res = 0;
+  while (length > 1 && res + 1 < LENGTH_BUCKETS) {
+    length >>= 1;
+    res++;
+  }
+  return res;
+}
+
+uint64_t peak_memory() {
+#ifdef CLEX_HAS_RUSAGE
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  // Linux 上单位是 KiB
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+} // namespace
+
+bool enabled() { return CLEX_METRICS != 0; }
+
+Metrics snapshot() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  Metrics res = r.retired;
+  for (const Counters *counters : r.live) {
+    counters->add_to(res);
+  }
+  res.peak_memory = peak_memory();
+  return res;
+}
+
+void reset() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.retired = Metrics();
+  for (Counters *counters : r.live) {
+    counters->clear();
+  }
+}
+
+const char *name(Routine routine) {
+  switch (routine) {
+  case Routine::Op:
+    return "op";
+  case Routine::Ident:
+    return "ident";
+  case Routine::Number:
+    return "number";
+  case Routine::String:
+    return "string";
+  case Routine::Char:
+    return "char";
+  case Routine::LineComment:
+    return "line_comment";
+  case Routine::BlockComment:
+    return "block_comment";
+  }
+  return "";
+}
+
+const char *name(Token::TokenType type) {
+  switch (type) {
+  case Token::TokenType::OP:
+    return "op";
+  case Token::TokenType::ReservedWord:
+    return "reserved";
+  case Token::TokenType::Ident:
+    return "ident";
+  case Token::TokenType::Number:
+    return "number";
+  case Token::TokenType::String:
+    return "string";
+  case Token::TokenType::Char:
+    return "char";
+  case Token::TokenType::Null:
+    return "null";
+  }
+  return "";
+}
+
+void record_time(Routine routine, uint64_t ns) {
+  Counters &c = local();
+  Counters::add(c.calls[static_cast<size_t>(routine)], 1);
+  Counters::add(c.ns[static_cast<size_t>(routine)], ns);
+}
+
+void record_token(Token::TokenType type, size_t length) {
+  size_t kind = static_cast<size_t>(type);
+  if (kind >= KIND_COUNT) {
+    return;
+  }
+  Counters &c = local();
+  Counters::add(c.tokens[kind], 1);
+  Counters::add(c.bytes[kind], length);
+  Counters::add(c.lengths[kind][bucket(length)], 1);
+  if (length > c.longest.load(std::memory_order_relaxed)) {
+    c.longest.store(length, std::memory_order_relaxed);
+    c.longest_type.store(static_cast<int>(type), std::memory_order_relaxed);
+  }
+}
+
+void record_refill() { Counters::add(local().refills, 1); }
+
+std::string Metrics::json() const {
+  fmt::memory_buffer out;
+  auto it = std::back_inserter(out);
+  fmt::format_to(it, "{{\n  \"routines\": {{");
+  for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+    fmt::format_to(it, "{}\n    \"{}\": {{\"calls\": {}, \"ns\": {}}}",
+                   i == 0 ? "" : ",", name(static_cast<Routine>(i)),
+                   this->routines[i].calls, this->routines[i].ns);
+  }
+  fmt::format_to(it, "\n  }},\n  \"tokens\": {{");
+  for (size_t i = 0; i < KIND_COUNT; i++) {
+    fmt::format_to(it, "{}\n    \"{}\": {{\"count\": {}, \"bytes\": {}, "
+                       "\"lengths\": [",
+                   i == 0 ? "" : ",", name(static_cast<Token::TokenType>(i)),
+                   this->tokens[i], this->bytes[i]);
+    for (size_t j = 0; j < LENGTH_BUCKETS; j++) {
+      fmt::format_to(it, "{}{}", j == 0 ? "" : ", ", this->lengths[i][j]);
+    }
+    fmt::format_to(it, "]}}");
+  }
+  fmt::format_to(it,
+                 "\n  }},\n  \"refills\": {},\n  \"longest_token\": "
+                 "{{\"length\": {}, \"type\": \"{}\"}},\n"
+                 "  \"peak_memory_bytes\": {}\n}}\n",
+                 this->refills, this->longest, name(this->longest_type),
+                 this->peak_memory);
+  return fmt::to_string(out);
+}
+
+std::string Metrics::prometheus() const {
+  fmt::memory_buffer out;
+  auto it = std::back_inserter(out);
+  fmt::format_to(it, "# TYPE clex_routine_calls_total counter\n");
+  for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+    fmt::format_to(it, "clex_routine_calls_total{{routine=\"{}\"}} {}\n",
+                   name(static_cast<Routine>(i)), this->routines[i].calls);
+  }
+  fmt::format_to(it, "# TYPE clex_routine_seconds_total counter\n");
+  for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+    fmt::format_to(it, "clex_routine_seconds_total{{routine=\"{}\"}} {}\n",
+                   name(static_cast<Routine>(i)),
+                   static_cast<double>(this->routines[i].ns) / 1e9);
+  }
+  // 桶的上界是 2^(i+1) - 1，按 Prometheus 的约定累加
+  fmt::format_to(it, "# TYPE clex_token_length_bytes histogram\n");
+  for (size_t i = 0; i < KIND_COUNT; i++) {
+    const char *kind = name(static_cast<Token::TokenType>(i));
+    uint64_t total = 0;
+    for (size_t j = 0; j + 1 < LENGTH_BUCKETS; j++) {
+      total += this->lengths[i][j];
+      fmt::format_to(it, "clex_token_length_bytes_bucket{{kind=\"{}\",le=\"{}\"}} {}\n",
+                     kind, (uint64_t(2) << j) - 1, total);
+    }
+    fmt::format_to(it, "clex_token_length_bytes_bucket{{kind=\"{}\",le=\"+Inf\"}} {}\n",
+                   kind, this->tokens[i]);
+    fmt::format_to(it, "clex_token_length_bytes_sum{{kind=\"{}\"}} {}\n", kind,
+                   this->bytes[i]);
+    fmt::format_to(it, "clex_token_length_bytes_count{{kind=\"{}\"}} {}\n",
+                   kind, this->tokens[i]);
+  }
+  fmt::format_to(it,
+                 "# TYPE clex_reader_refills_total counter\n"
+                 "clex_reader_refills_total {}\n"
+                 "# TYPE clex_longest_token_bytes gauge\n"
+                 "clex_longest_token_bytes{{kind=\"{}\"}} {}\n"
+                 "# TYPE clex_peak_memory_bytes gauge\n"
+                 "clex_peak_memory_bytes {}\n",
+                 this->refills, name(this->longest_type), this->longest,
+                 this->peak_memory);
+  return fmt::to_string(out);
+}
+
+void Metrics::report() const {
+  for (size_t i = 0; i < ROUTINE_COUNT; i++) {
+    if (this->routines[i].calls == 0) {
+      continue;
+    }
+    PLOGI << fmt::format("{}: 调用 {} 次, 共 {:.3f} ms",
+                         name(static_cast<Routine>(i)),
+                         this->routines[i].calls,
+                         static_cast<double>(this->routines[i].ns) / 1e6);
+  }
+  for (size_t i = 0; i < KIND_COUNT; i++) {
+    if (this->tokens[i] == 0) {
+      continue;
+    }
+    PLOGI << fmt::format("{}: {} 个, 共 {} 字节",
+                         name(static_cast<Token::TokenType>(i)),
+                         this->tokens[i], this->bytes[i]);
+  }
+  PLOGI << "缓冲读入次数: " << this->refills;
+  PLOGI << "最长Token: " << this->longest << " (" << name(this->longest_type)
+        << ")";
+  PLOGI << "峰值内存: " << this->peak_memory;
+}
+
+} // namespace metrics
@@ -0,0 +1,186 @@
+#include "number.h"
+#include <array>
+
+namespace number {
+
+namespace {
+
+enum : State {
+  S_START,
+  S_SIGN,
+  S_ZERO,       // 0
+  S_DEC,        // [1-9]\d*
+  S_OCT,        // 0[1-7][0-7]*
+  S_DIGITS,     // 只能作为小数整数部分的数字串，如 09
+  S_DOT_LEAD,   // .
+  S_FRAC,       // 1.  .5  1.5
+  S_EXP,        // 1.5e
+  S_EXP_SIGN,   // 1.5e-
+  S_EXP_DIG,    // 1.5e10
+  S_HEX_X,      // 0x
+  S_HEX_INT,    // 0x[1-9a-f][0-9a-f]*
+  S_HEX_PRE,    // 0x0...，只能作为十六进制小数的整数部分
+  S_HEX_DOT_NZ, // 小数点后第一位必须非 0
+  S_HEX_FRAC,   // 小数部分，等待 p
+  S_HEX_P,      // p
+  S_HEX_P_SIGN, // p-
+  S_HEX_EXP,    // p[0-9a-f]+
+  S_SUF_U,      // u
+  S_SUF_L,      // l
+  S_SUF_END,    // ul lu
+  S_REJECT,
+  STATE_COUNT,
+};
+
+enum Class : uint8_t {
+  C_0,
+  C_17,
+  C_89,
+  C_HEX, // a b c d f
+  C_E,
+  C_X,
+  C_P,
+  C_U,
+  C_L,
+  C_DOT,
+  C_SIGN,
+  C_OTHER,
+  CLASS_COUNT,
+};
+
+constexpr std::array<uint8_t, 256> make_classes() {
+  std::array<uint8_t, 256> res{};
+  for (int c = 0; c < 256; c++) {
+    res[c] = C_OTHER;
+  }
+  res['0'] = C_0;
+  for (int c = '1'; c <= '7'; c++) {
+    res[c] = C_17;
+  }
+  res['8'] = res['9'] = C_89;
+  res['a'] = res['b'] = res['c'] = res['d'] = res['f'] = C_HEX;
+  res['e'] = C_E;
+  res['x'] = C_X;
+  res['p'] = C_P;
+  res['u'] = C_U;
+  res['l'] = C_L;
+  res['.'] = C_DOT;
+  res['+'] = res['-'] = C_SIGN;
+  return res;
+}
+
+using Table = std::array<std::array<State, CLASS_COUNT>, STATE_COUNT>;
+
+constexpr void on_digits(Table &t, State from, State to) {
+  t[from][C_0] = t[from][C_17] = t[from][C_89] = to;
+}
+
+constexpr void on_hex(Table &t, State from, State to) {
+  on_digits(t, from, to);
+  t[from][C_HEX] = t[from][C_E] = to;
+}
+
+constexpr void on_suffix(Table &t, State from) {
+  t[from][C_U] = S_SUF_U;
+  t[from][C_L] = S_SUF_L;
+}
+
+constexpr Table make_table() {
+  Table t{};
+  for (auto &row : t) {
+    for (auto &to : row) {
+      to = S_REJECT;
+    }
+  }
+  t[S_START][C_SIGN] = S_SIGN;
+  for (State s : {S_START, S_SIGN}) {
+    t[s][C_0] = S_ZERO;
+    t[s][C_17] = t[s][C_89] = S_DEC;
+    t[s][C_DOT] = S_DOT_LEAD;
+  }
+
+  t[S_ZERO][C_0] = t[S_ZERO][C_89] = S_DIGITS;
+  t[S_ZERO][C_17] = S_OCT;
+  t[S_ZERO][C_X] = S_HEX_X;
+  t[S_ZERO][C_DOT] = S_FRAC;
+  on_suffix(t, S_ZERO);
+
+  on_digits(t, S_DEC, S_DEC);
+  t[S_DEC][C_DOT] = S_FRAC;
+  on_suffix(t, S_DEC);
+
+  t[S_OCT][C_0] = t[S_OCT][C_17] = S_OCT;
+  t[S_OCT][C_89] = S_DIGITS;
+  t[S_OCT][C_DOT] = S_FRAC;
+  on_suffix(t, S_OCT);
+
+  on_digits(t, S_DIGITS, S_DIGITS);
+  t[S_DIGITS][C_DOT] = S_FRAC;
+
+  on_digits(t, S_DOT_LEAD, S_FRAC);
+
+  on_digits(t, S_FRAC, S_FRAC);
+  t[S_FRAC][C_E] = S_EXP;
+  on_suffix(t, S_FRAC);
+
+  t[S_EXP][C_SIGN] = S_EXP_SIGN;
+  on_digits(t, S_EXP, S_EXP_DIG);
+  on_digits(t, S_EXP_SIGN, S_EXP_DIG);
+  on_digits(t, S_EXP_DIG, S_EXP_DIG);
+  on_suffix(t, S_EXP_DIG);
+
+  on_hex(t, S_HEX_X, S_HEX_INT);
+  t[S_HEX_X][C_0] = S_HEX_PRE;
+  t[S_HEX_X][C_DOT] = S_HEX_DOT_NZ;
+
+  on_hex(t, S_HEX_INT, S_HEX_INT);
+  t[S_HEX_INT][C_DOT] = S_HEX_FRAC;
+  on_suffix(t, S_HEX_INT);
+
+  on_hex(t, S_HEX_PRE, S_HEX_PRE);
+  t[S_HEX_PRE][C_DOT] = S_HEX_DOT_NZ;
+
+  on_hex(t, S_HEX_DOT_NZ, S_HEX_FRAC);
+  t[S_HEX_DOT_NZ][C_0] = S_REJECT;
+
+  on_hex(t, S_HEX_FRAC, S_HEX_FRAC);
+  t[S_HEX_FRAC][C_P] = S_HEX_P;
+
+  t[S_HEX_P][C_SIGN] = S_HEX_P_SIGN;
+  on_hex(t, S_HEX_P, S_HEX_EXP);
+  on_hex(t, S_HEX_P_SIGN, S_HEX_EXP);
+  on_hex(t, S_HEX_EXP, S_HEX_EXP);
+  on_suffix(t, S_HEX_EXP);
+
+  t[S_SUF_U][C_L] = S_SUF_END;
+  t[S_SUF_L][C_U] = S_SUF_END;
+  return t;
+}
+
+constexpr std::array<uint8_t, 256> classes = make_classes();
+
+constexpr Table table = make_table();
+
+constexpr bool accepting[STATE_COUNT] = {
+    false, false, true,  true,  true,  false, false, true,
+    false, false, true,  false, true,  false, false, false,
+    false, false, true,  true,  true,  true,  false,
+};
+
+} // namespace
+
+State step(State state, char c) {
+  return table[state][classes[static_cast<unsigned char>(c)]];
+}
+
+bool accept(State state) { return accepting[state]; }
+
+bool is_valid(std::string_view text) {
+  State state = START;
+  for (char c : text) {
+    state = step(state, c);
+  }
+  return accept(state);
+}
+
+} // namespace number
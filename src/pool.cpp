@@ -0,0 +1,99 @@
+#include "pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads)
+    : queued(0), pending(0), next_queue(0), stopping(false) {
+  // hardware_concurrency 取不到时返回 0
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; i++) {
+    this->queues.emplace_back(new Queue());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    this->workers.emplace_back([this, i] { this->run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->work_cv.notify_all();
+  for (auto &worker : this->workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    // 入队和计数在同一把锁里，线程不会在 queued 增加前取走任务
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Queue &queue = *this->queues[this->next_queue];
+    this->next_queue = (this->next_queue + 1) % this->queues.size();
+    {
+      std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    this->queued++;
+    this->pending++;
+  }
+  this->work_cv.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->done_cv.wait(lock, [this] { return this->pending == 0; });
+  if (this->error) {
+    std::exception_ptr error = this->error;
+    this->error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+size_t ThreadPool::size() const { return this->workers.size(); }
+
+bool ThreadPool::take(size_t id, std::function<void()> &task) {
+  // 先取自己的队列，再依次偷其他线程的
+  for (size_t k = 0; k < this->queues.size(); k++) {
+    Queue &queue = *this->queues[(id + k) % this->queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run(size_t id) {
+  while (true) {
+    std::function<void()> task;
+    if (this->take(id, task)) {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->queued--;
+      }
+      std::exception_ptr error;
+      try {
+        task();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (error && !this->error) {
+        this->error = error;
+      }
+      if (--this->pending == 0) {
+        this->done_cv.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->work_cv.wait(lock,
+                       [this] { return this->stopping || this->queued > 0; });
+    if (this->stopping && this->queued == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,155 @@
+#include "read_ahead.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <unistd.h>
+
+ReadAhead::ReadAhead(int fd)
+    : fd(fd), produced(0), consumed(0), done(false), stop(false), cursor(0) {
+  if (pipe(this->wake) != 0) {
+    close(fd);
+    throw "can not create pipe for ReadAhead";
+  }
+  this->memory = static_cast<char *>(
+      std::aligned_alloc(READ_AHEAD_ALIGN, READ_AHEAD_BLOCK * READ_AHEAD_BLOCKS));
+  if (this->memory == nullptr) {
+    close(fd);
+    close(this->wake[0]);
+    close(this->wake[1]);
+    throw "can not allocate buffer for ReadAhead";
+  }
+  for (size_t i = 0; i < READ_AHEAD_BLOCKS; i++) {
+    this->blocks[i] = Block{this->memory + i * READ_AHEAD_BLOCK, 0};
+  }
+  try {
+    this->producer = std::thread(&ReadAhead::run, this);
+  } catch (const std::system_error &) {
+    close(fd);
+    close(this->wake[0]);
+    close(this->wake[1]);
+    std::free(this->memory);
+    throw "can not start the ReadAhead thread";
+  }
+}
+
+ReadAhead::~ReadAhead() {
+  this->stop.store(true);
+  // 生产者可能在等空闲的块，也可能阻塞在 poll 上
+  this->notify(this->not_full);
+  char c = 0;
+  while (write(this->wake[1], &c, 1) < 0 && errno == EINTR) {
+  }
+  this->producer.join();
+  close(this->fd);
+  close(this->wake[0]);
+  close(this->wake[1]);
+  std::free(this->memory);
+}
+
+void ReadAhead::notify(std::condition_variable &cv) {
+  // 先拿一次锁，保证等待的一方不会在检查条件之后、睡眠之前错过通知
+  { std::lock_guard<std::mutex> lock(this->mutex); }
+  cv.notify_one();
+}
+
+bool ReadAhead::fill(Block &block) {
+  while (true) {
+    struct pollfd fds[2] = {{this->fd, POLLIN, 0}, {this->wake[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (fds[1].revents != 0) {
+      return false;
+    }
+    ssize_t got = ::read(this->fd, block.data, READ_AHEAD_BLOCK);
+    if (got < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      return false;
+    }
+    // 不等块被填满，管道另一端写得慢时也能尽早开始解析
+    block.size = got;
+    return got > 0;
+  }
+}
+
+void ReadAhead::run() {
+  while (!this->stop.load()) {
+    size_t n = this->produced.load(std::memory_order_relaxed);
+    if (n - this->consumed.load(std::memory_order_acquire) ==
+        READ_AHEAD_BLOCKS) {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->not_full.wait(lock, [this, n] {
+        return this->stop.load() ||
+               n - this->consumed.load(std::memory_order_acquire) <
+                   READ_AHEAD_BLOCKS;
+      });
+      continue;
+    }
+    if (!this->fill(this->blocks[n % READ_AHEAD_BLOCKS])) {
+      break;
+    }
+    this->produced.store(n + 1, std::memory_order_release);
+    this->notify(this->not_empty);
+  }
+  this->done.store(true, std::memory_order_release);
+  this->notify(this->not_empty);
+}
+
+size_t ReadAhead::read(char *out, size_t n) {
+  size_t res = 0;
+  while (res < n) {
+    size_t k = this->consumed.load(std::memory_order_relaxed);
+    if (k == this->produced.load(std::memory_order_acquire)) {
+      if (res > 0) {
+        // 已经有数据，不等生产者
+        break;
+      }
+      // done 在最后一块发布之后才设置，看到 done 后需要再检查一次
+      if (this->done.load(std::memory_order_acquire)) {
+        if (k == this->produced.load(std::memory_order_acquire)) {
+          break;
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->not_empty.wait(lock, [this, k] {
+        return this->done.load(std::memory_order_acquire) ||
+               k != this->produced.load(std::memory_order_acquire);
+      });
+      continue;
+    }
+    const Block &block = this->blocks[k % READ_AHEAD_BLOCKS];
+    size_t len = std::min(n - res, block.size - this->cursor);
+    memcpy(out + res, block.data + this->cursor, len);
+    res += len;
+    this->cursor += len;
+    if (this->cursor == block.size) {
+      this->cursor = 0;
+      this->consumed.store(k + 1, std::memory_order_release);
+      this->notify(this->not_full);
+    }
+  }
+  return res;
+}
+
+#else
+
+ReadAhead::ReadAhead(int fd) : fd(fd) {
+  throw "ReadAhead is not supported on this platform";
+}
+
+ReadAhead::~ReadAhead() {}
+
+size_t ReadAhead::read(char *, size_t) { return 0; }
+
+#endif
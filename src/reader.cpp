@@ -1,50 +1,238 @@
 #include "reader.h"
+#include "metrics.h"
+#include "read_ahead.h"
+#include "scan.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define CLEX_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef CLEX_METRICS
+#define CLEX_METRICS 0
+#endif
+
 Reader::Reader(const char *path)
-    : index(0), front_index(1), p_index(Position{1, 1}),
-      p_front_index(Position{1, 2}), count_(0) {
+    : eof_(false), index(0), front_index(1), fill_(0), read_offset_(0),
+      data_(nullptr),
+      size_(0), offset_(0), capturing_(false), mapping_(nullptr),
+      mapping_size_(0), count_(0) {
+#ifdef CLEX_HAS_MMAP
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    if (this->map_file(fd)) {
+      close(fd);
+      return;
+    }
+    // 同一个 fd 交给预读，管道不能关闭后重新打开
+    this->read_ahead_ = std::make_unique<ReadAhead>(fd);
+  } else {
+    this->file = std::ifstream(path);
+  }
+#else
   this->file = std::ifstream(path);
+#endif
+  if (this->read_ahead_ == nullptr && !this->file.is_open()) {
+    throw "can not open the source file";
+  }
   memset(this->buffer, 0, 2 * READER_BUFFER);
-  this->read_buffer(buffer);
+  // 当前指针和前向指针都要有内容
+  while (this->fill_ <= this->front_index) {
+    this->read_buffer();
+  }
+}
+
+Reader::Reader(std::string_view source, size_t offset)
+    : eof_(false), index(offset), front_index(offset + 1), fill_(0),
+      read_offset_(0),
+      data_(source.data() != nullptr ? source.data() : ""),
+      size_(source.size()), offset_(0), capturing_(false), mapping_(nullptr),
+      mapping_size_(0), count_(0) {}
+
+Reader::Reader(std::string_view source) : Reader(source, 0) {}
+
+Reader::~Reader() {
+#ifdef CLEX_HAS_MMAP
+  if (this->mapping_ != nullptr) {
+    munmap(this->mapping_, this->mapping_size_);
+  }
+#endif
+}
+
+bool Reader::map_file(int fd) {
+#ifdef CLEX_HAS_MMAP
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    // 管道、字符设备等无法映射，交给预读
+    return false;
+  }
+  if (st.st_size == 0) {
+    this->data_ = "";
+    return true;
+  }
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  madvise(p, st.st_size, MADV_WILLNEED);
+  this->mapping_ = p;
+  this->mapping_size_ = st.st_size;
+  this->data_ = static_cast<const char *>(p);
+  this->size_ = st.st_size;
+  return true;
+#else
+  (void)fd;
+  return false;
+#endif
 }
 
 void Reader::ahead() {
   this->index = this->front_index;
-  this->p_index.col = this->p_front_index.col;
-  this->p_index.row = this->p_front_index.row;
+  this->offset_ = this->count_ + 1;
   this->front_ahead();
 }
 
 void Reader::front_ahead() {
-  this->count_++;
-  this->front_index = (this->front_index + 1) % (READER_BUFFER * 2);
-  if (this->front_index == 0) {
-    this->read_buffer(this->buffer);
-    memset(this->buffer + READER_BUFFER, 0, READER_BUFFER);
-  } else if (this->front_index == READER_BUFFER) {
-    this->read_buffer(this->buffer + READER_BUFFER);
-    memset(this->buffer, 0, READER_BUFFER);
-  }
-  if (this->front_peek() == '\n') {
-    this->p_front_index.row += 1;
-    this->p_front_index.col = 0;
+  if (this->data_ != nullptr) {
+    this->front_index++;
+  } else {
+    this->count_++;
+    if (this->capturing_) {
+      this->capture_.push_back(this->buffer[this->front_index]);
+    }
+    this->front_index = (this->front_index + 1) % (READER_BUFFER * 2);
+    // 读入的位置总在前向指针之后，不会覆盖前向指针指向的字符；
+    // 但单词长于一半缓冲时，当前指针指向的字符可能已经被新读入的内容覆盖。
+    // 单词开头的字符在 begin_lexeme 时就已读出，之后的内容逐个存进 capture_，
+    // end_lexeme 只从 capture_ 取，解析过程中不会再回头读当前指针的字符
+    if (this->front_index == this->fill_) {
+      this->read_buffer();
+    }
+  }
+}
+
+void Reader::front_skip(size_t n) { this->front_index += n; }
+
+void Reader::seek(size_t offset) {
+  this->index = offset;
+  this->front_index = offset + 1;
+}
+
+bool Reader::is_front_eof() const {
+  if (this->data_ != nullptr) {
+    return this->front_index >= this->size_;
+  }
+  return this->eof_ && this->front_peek() == '\0';
+}
+
+char Reader::peek() const {
+  if (this->data_ != nullptr) {
+    return this->index < this->size_ ? this->data_[this->index] : '\0';
+  }
+  return this->buffer[this->index];
+}
+
+char Reader::front_peek() const {
+  if (this->data_ != nullptr) {
+    return this->front_index < this->size_ ? this->data_[this->front_index]
+                                           : '\0';
+  }
+  return this->buffer[this->front_index];
+}
+
+bool Reader::is_eof() const {
+  if (this->data_ != nullptr) {
+    return this->index >= this->size_;
+  }
+  return this->eof_;
+}
+
+void Reader::read_buffer() {
+  char *at = this->buffer + this->fill_;
+  size_t got = 0;
+  if (!this->eof_) {
+#if CLEX_METRICS
+    metrics::record_refill();
+#endif
+    size_t end = this->fill_ < READER_BUFFER ? READER_BUFFER : READER_BUFFER * 2;
+    if (this->read_ahead_ != nullptr) {
+      // 有数据就返回，写得慢的管道不会让解析等满一整块
+      got = this->read_ahead_->read(at, end - this->fill_);
+    } else {
+      this->file.read(at, end - this->fill_);
+      got = this->file.gcount();
+    }
+    this->eof_ = got == 0;
+  }
+  if (got == 0) {
+    // 结尾之后的字符都是 '\0'
+    *at = '\0';
+    got = 1;
   } else {
-    this->p_front_index.col += 1;
+    scan::find_newlines(at, got, this->read_offset_, this->lines_);
+    this->read_offset_ += got;
   }
+  this->fill_ = (this->fill_ + got) % (READER_BUFFER * 2);
 }
 
-char Reader::peek() const { return this->buffer[this->index]; }
+Position Reader::pos() const { return this->locate(this->offset()); }
 
-char Reader::front_peek() const { return this->buffer[this->front_index]; }
+const std::vector<size_t> &Reader::lines() const {
+  if (this->data_ != nullptr) {
+    std::call_once(this->lines_once_, [this] {
+      scan::find_newlines(this->data_, this->size_, 0, this->lines_);
+    });
+  }
+  return this->lines_;
+}
 
-bool Reader::is_eof() const { return this->file.eof(); }
+Position Reader::locate(size_t offset) const {
+  const std::vector<size_t> &lines = this->lines();
+  // 换行符本身算作下一行的第 0 列
+  size_t k = std::upper_bound(lines.begin(), lines.end(), offset) -
+             lines.begin();
+  if (k == 0) {
+    return Position{1, offset + 1};
+  }
+  return Position{k + 1, offset - lines[k - 1]};
+}
+
+size_t Reader::count() const {
+  return this->data_ != nullptr ? this->front_index - 1 : this->count_;
+}
+
+bool Reader::is_contiguous() const { return this->data_ != nullptr; }
+
+std::string_view Reader::source() const {
+  if (this->data_ == nullptr) {
+    return std::string_view();
+  }
+  return std::string_view(this->data_, this->size_);
+}
 
-void Reader::read_buffer(char *buffer) {
-  this->file.read(buffer, READER_BUFFER);
+size_t Reader::offset() const {
+  return this->data_ != nullptr ? this->index : this->offset_;
 }
 
-Position Reader::pos() const { return this->p_index; }
+void Reader::begin_lexeme() {
+  if (this->data_ == nullptr) {
+    this->capturing_ = true;
+    this->capture_.assign(1, this->peek());
+  }
+}
 
-size_t Reader::count() const { return this->count_; }
\ No newline at end of file
+std::string_view Reader::end_lexeme() {
+  if (this->data_ != nullptr) {
+    size_t end = std::min(this->front_index, this->size_);
+    return std::string_view(this->data_ + this->index, end - this->index);
+  }
+  this->capturing_ = false;
+  return std::string_view(this->capture_);
+}
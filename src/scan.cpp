@@ -0,0 +1,330 @@
+#include "scan.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CLEX_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace scan {
+
+namespace {
+
+inline bool is_continued(const char *p, size_t i) {
+  if (i >= 1 && p[i - 1] == '\\') {
+    return true;
+  }
+  return i >= 2 && p[i - 1] == '\r' && p[i - 2] == '\\';
+}
+
+size_t find_comment_end_scalar(const char *p, size_t n, size_t i) {
+  for (; i + 1 < n; i++) {
+    if (p[i] == '*' && p[i + 1] == '/') {
+      return i;
+    }
+  }
+  return n;
+}
+
+size_t find_line_end_scalar(const char *p, size_t n, size_t i) {
+  for (; i < n; i++) {
+    if (p[i] == '\n' && !is_continued(p, i)) {
+      return i;
+    }
+  }
+  return n;
+}
+
+void find_newlines_scalar(const char *p, size_t n, size_t i, size_t base,
+                          std::vector<size_t> &out) {
+  while (i < n) {
+    const char *q = static_cast<const char *>(memchr(p + i, '\n', n - i));
+    if (q == nullptr) {
+      return;
+    }
+    i = q - p;
+    out.push_back(base + i);
+    i++;
+  }
+}
+
+size_t run_scalar(const char *p, size_t n, size_t i, uint8_t cls) {
+  while (i < n && (byte_classes[static_cast<unsigned char>(p[i])] & cls)) {
+    i++;
+  }
+  return i;
+}
+
+#ifdef CLEX_SCAN_X86
+
+// 按高低半字节查表分类：lo[b & 0xf] & hi[b >> 4] 非 0 即属于该类
+//   bit0: '0'-'9'   bit1: 'A'-'O' 'a'-'o'   bit2: 'P'-'Z' 'p'-'z'
+//   bit3: '_'       bit4: '.'
+const int8_t RUN_LO[16] = {0x05, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07,
+                           0x07, 0x07, 0x06, 0x02, 0x02, 0x02, 0x12, 0x0a};
+const int8_t IDENT_HI[16] = {0, 0, 0, 0x01, 0x02, 0x0c, 0x02, 0x04,
+                             0, 0, 0, 0,    0,    0,    0,    0};
+const int8_t NUMBER_HI[16] = {0, 0, 0x10, 0x01, 0x02, 0x0c, 0x02, 0x04,
+                              0, 0, 0,    0,    0,    0,    0,    0};
+
+__attribute__((target("ssse3"))) size_t run_ssse3(const char *p, size_t n,
+                                                    const int8_t *hi_table,
+                                                    uint8_t cls) {
+  const __m128i lo_tbl =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(RUN_LO));
+  const __m128i hi_tbl =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi_table));
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(a, nibble));
+    __m128i hi = _mm_shuffle_epi8(
+        hi_tbl, _mm_and_si128(_mm_srli_epi16(a, 4), nibble));
+    unsigned mask =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return run_scalar(p, n, i, cls);
+}
+
+__attribute__((target("avx2"))) size_t run_avx2(const char *p, size_t n,
+                                                  const int8_t *hi_table,
+                                                  uint8_t cls) {
+  const __m256i lo_tbl = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(RUN_LO)));
+  const __m256i hi_tbl = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi_table)));
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(a, nibble));
+    __m256i hi = _mm256_shuffle_epi8(
+        hi_tbl, _mm256_and_si256(_mm256_srli_epi16(a, 4), nibble));
+    unsigned mask = _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return run_scalar(p, n, i, cls);
+}
+
+__attribute__((target("ssse3"))) size_t ident_run_ssse3(const char *p,
+                                                          size_t n) {
+  return run_ssse3(p, n, IDENT_HI, IDENT_BYTE);
+}
+
+__attribute__((target("ssse3"))) size_t number_run_ssse3(const char *p,
+                                                           size_t n) {
+  return run_ssse3(p, n, NUMBER_HI, NUMBER_BYTE);
+}
+
+__attribute__((target("avx2"))) size_t ident_run_avx2(const char *p,
+                                                       size_t n) {
+  return run_avx2(p, n, IDENT_HI, IDENT_BYTE);
+}
+
+__attribute__((target("avx2"))) size_t number_run_avx2(const char *p,
+                                                        size_t n) {
+  return run_avx2(p, n, NUMBER_HI, NUMBER_BYTE);
+}
+
+// 依次处理 mask 中为 1 的位，返回第一个不是续行的换行
+inline bool first_line_end(const char *p, size_t base, unsigned mask,
+                           size_t &res) {
+  while (mask != 0) {
+    size_t i = base + __builtin_ctz(mask);
+    if (!is_continued(p, i)) {
+      res = i;
+      return true;
+    }
+    mask &= mask - 1;
+  }
+  return false;
+}
+
+__attribute__((target("sse2"))) size_t find_comment_end_sse2(const char *p,
+                                                              size_t n) {
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i slash = _mm_set1_epi8('/');
+  size_t i = 0;
+  for (; i + 17 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + 1));
+    unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, star), _mm_cmpeq_epi8(b, slash)));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return find_comment_end_scalar(p, n, i);
+}
+
+__attribute__((target("sse2"))) size_t find_line_end_sse2(const char *p,
+                                                           size_t n) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t i = 0;
+  size_t res;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, nl));
+    if (first_line_end(p, i, mask, res)) {
+      return res;
+    }
+  }
+  return find_line_end_scalar(p, n, i);
+}
+
+__attribute__((target("sse2"))) void
+find_newlines_sse2(const char *p, size_t n, size_t base,
+                   std::vector<size_t> &out) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, nl));
+    while (mask != 0) {
+      out.push_back(base + i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  find_newlines_scalar(p, n, i, base, out);
+}
+
+__attribute__((target("avx2"))) size_t find_comment_end_avx2(const char *p,
+                                                              size_t n) {
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i slash = _mm256_set1_epi8('/');
+  size_t i = 0;
+  for (; i + 33 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + 1));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(a, star), _mm256_cmpeq_epi8(b, slash)));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return find_comment_end_scalar(p, n, i);
+}
+
+__attribute__((target("avx2"))) size_t find_line_end_avx2(const char *p,
+                                                           size_t n) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t i = 0;
+  size_t res;
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl));
+    if (first_line_end(p, i, mask, res)) {
+      return res;
+    }
+  }
+  return find_line_end_scalar(p, n, i);
+}
+
+__attribute__((target("avx2"))) void
+find_newlines_avx2(const char *p, size_t n, size_t base,
+                   std::vector<size_t> &out) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl));
+    while (mask != 0) {
+      out.push_back(base + i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  find_newlines_scalar(p, n, i, base, out);
+}
+
+#endif
+
+size_t find_comment_end_generic(const char *p, size_t n) {
+  return find_comment_end_scalar(p, n, 0);
+}
+
+size_t find_line_end_generic(const char *p, size_t n) {
+  return find_line_end_scalar(p, n, 0);
+}
+
+void find_newlines_generic(const char *p, size_t n, size_t base,
+                           std::vector<size_t> &out) {
+  find_newlines_scalar(p, n, 0, base, out);
+}
+
+size_t ident_run_generic(const char *p, size_t n) {
+  return run_scalar(p, n, 0, IDENT_BYTE);
+}
+
+size_t number_run_generic(const char *p, size_t n) {
+  return run_scalar(p, n, 0, NUMBER_BYTE);
+}
+
+struct Kernels {
+  size_t (*find_comment_end)(const char *, size_t);
+  size_t (*find_line_end)(const char *, size_t);
+  void (*find_newlines)(const char *, size_t, size_t, std::vector<size_t> &);
+  size_t (*ident_run)(const char *, size_t);
+  size_t (*number_run)(const char *, size_t);
+};
+
+Kernels pick() {
+  Kernels k{find_comment_end_generic, find_line_end_generic,
+            find_newlines_generic,    ident_run_generic,
+            number_run_generic};
+#ifdef CLEX_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernels{find_comment_end_avx2, find_line_end_avx2,
+                   find_newlines_avx2,    ident_run_avx2,
+                   number_run_avx2};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    k.find_comment_end = find_comment_end_sse2;
+    k.find_line_end = find_line_end_sse2;
+    k.find_newlines = find_newlines_sse2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    k.ident_run = ident_run_ssse3;
+    k.number_run = number_run_ssse3;
+  }
+#endif
+  return k;
+}
+
+const Kernels &kernels() {
+  static const Kernels k = pick();
+  return k;
+}
+
+} // namespace
+
+size_t find_comment_end(const char *p, size_t n) {
+  return kernels().find_comment_end(p, n);
+}
+
+size_t find_line_end(const char *p, size_t n) {
+  return kernels().find_line_end(p, n);
+}
+
+void find_newlines(const char *p, size_t n, size_t base,
+                   std::vector<size_t> &out) {
+  kernels().find_newlines(p, n, base, out);
+}
+
+size_t ident_run(const char *p, size_t n) { return kernels().ident_run(p, n); }
+
+size_t number_run(const char *p, size_t n) {
+  return kernels().number_run(p, n);
+}
+
+} // namespace scan
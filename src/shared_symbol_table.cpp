@@ -0,0 +1,64 @@
+#include "shared_symbol_table.h"
+#include "hash.h"
+#include <mutex>
+
+SharedSymbolTable::SharedSymbolTable() {}
+
+size_t SharedSymbolTable::shard_of(std::string_view text) {
+  // 分片内的表用哈希的低位定位，这里取高位，两者互不相关
+  return hash::fnv1a(text.data(), text.size()) >> (64 - SYMBOL_SHARD_BITS);
+}
+
+Symbol SharedSymbolTable::intern(std::string_view text) {
+  size_t i = shard_of(text);
+  Shard &shard = this->shards[i];
+  Symbol local;
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    local = shard.table.find(text);
+  }
+  if (local == NO_SYMBOL) {
+    // 加写锁前可能已经被别的线程插入，intern 会返回同一个编号
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    local = shard.table.intern(text);
+  }
+  if (local >= (NO_SYMBOL >> SYMBOL_SHARD_BITS)) {
+    throw "too many identifiers for SharedSymbolTable";
+  }
+  return (local << SYMBOL_SHARD_BITS) | static_cast<Symbol>(i);
+}
+
+Symbol SharedSymbolTable::find(std::string_view text) const {
+  size_t i = shard_of(text);
+  const Shard &shard = this->shards[i];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  Symbol local = shard.table.find(text);
+  if (local == NO_SYMBOL) {
+    return NO_SYMBOL;
+  }
+  return (local << SYMBOL_SHARD_BITS) | static_cast<Symbol>(i);
+}
+
+std::string_view SharedSymbolTable::spelling(Symbol symbol) const {
+  const Shard &shard = this->shards[symbol & (SYMBOL_SHARDS - 1)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.table.spelling(symbol >> SYMBOL_SHARD_BITS);
+}
+
+size_t SharedSymbolTable::size() const {
+  size_t res = 0;
+  for (const Shard &shard : this->shards) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    res += shard.table.size();
+  }
+  return res;
+}
+
+size_t SharedSymbolTable::memory() const {
+  size_t res = 0;
+  for (const Shard &shard : this->shards) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    res += shard.table.memory();
+  }
+  return res;
+}
@@ -0,0 +1,86 @@
+#include "symbol_table.h"
+#include "hash.h"
+
+static uint32_t hash_of(std::string_view text) {
+  uint64_t h = hash::fnv1a(text.data(), text.size());
+  return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// 探测时用 size - 1 作掩码，槽数必须是 2 的幂
+static size_t round_up(size_t capacity) {
+  size_t res = 1;
+  while (res < capacity) {
+    res <<= 1;
+  }
+  return res;
+}
+
+SymbolTable::SymbolTable(size_t capacity)
+    : slots(round_up(capacity), Slot{0, NO_SYMBOL}) {}
+
+size_t SymbolTable::probe(std::string_view text, uint32_t hash) const {
+  size_t mask = this->slots.size() - 1;
+  size_t i = hash & mask;
+  while (true) {
+    const Slot &slot = this->slots[i];
+    if (slot.symbol == NO_SYMBOL ||
+        (slot.hash == hash && this->spellings[slot.symbol] == text)) {
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+Symbol SymbolTable::intern(std::string_view text) {
+  uint32_t hash = hash_of(text);
+  size_t i = this->probe(text, hash);
+  if (this->slots[i].symbol != NO_SYMBOL) {
+    this->counts[this->slots[i].symbol]++;
+    return this->slots[i].symbol;
+  }
+  if (this->spellings.size() >= NO_SYMBOL) {
+    throw "too many identifiers for SymbolTable";
+  }
+  Symbol symbol = static_cast<Symbol>(this->spellings.size());
+  this->spellings.push_back(this->arena.copy(text));
+  this->counts.push_back(1);
+  this->slots[i] = Slot{hash, symbol};
+  if (this->spellings.size() * 2 > this->slots.size()) {
+    this->grow();
+  }
+  return symbol;
+}
+
+Symbol SymbolTable::find(std::string_view text) const {
+  return this->slots[this->probe(text, hash_of(text))].symbol;
+}
+
+std::string_view SymbolTable::spelling(Symbol symbol) const {
+  return this->spellings[symbol];
+}
+
+size_t SymbolTable::count(Symbol symbol) const { return this->counts[symbol]; }
+
+size_t SymbolTable::size() const { return this->spellings.size(); }
+
+size_t SymbolTable::memory() const {
+  return this->slots.capacity() * sizeof(Slot) +
+         this->spellings.capacity() * sizeof(std::string_view) +
+         this->counts.capacity() * sizeof(size_t) + this->arena.reserved();
+}
+
+void SymbolTable::grow() {
+  std::vector<Slot> old(this->slots.size() * 2, Slot{0, NO_SYMBOL});
+  old.swap(this->slots);
+  size_t mask = this->slots.size() - 1;
+  for (const Slot &slot : old) {
+    if (slot.symbol == NO_SYMBOL) {
+      continue;
+    }
+    size_t i = slot.hash & mask;
+    while (this->slots[i].symbol != NO_SYMBOL) {
+      i = (i + 1) & mask;
+    }
+    this->slots[i] = slot;
+  }
+}
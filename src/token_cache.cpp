@@ -0,0 +1,137 @@
+#include "token_cache.h"
+#include "hash.h"
+#include "lex.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fmt/format.h>
+#include <plog/Log.h>
+#include <exception>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// 缓存文件的后缀，淘汰时只看这些文件
+static const char SUFFIX[] = ".clxt";
+
+TokenCache::TokenCache(std::string dir, uint64_t max_bytes)
+    : dir(std::move(dir)), max_bytes(max_bytes), bytes(0), _hits(0),
+      _misses(0), serial(0) {
+  std::error_code ec;
+  fs::create_directories(this->dir, ec);
+  uint64_t total = 0;
+  for (fs::directory_iterator it(this->dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (it->path().extension() == SUFFIX) {
+      total += it->file_size(ec);
+    }
+  }
+  this->bytes = total;
+}
+
+std::string TokenCache::key(std::string_view source) const {
+  uint64_t h = hash::xxh64(source.data(), source.size());
+  return (fs::path(this->dir) / fmt::format("{:016x}-{}-v{}.{}{}", h,
+                                            source.size(), LEXER_VERSION,
+                                            TOKEN_FILE_VERSION, SUFFIX))
+      .string();
+}
+
+std::unique_ptr<TokenFile> TokenCache::find(std::string_view source,
+                                            const std::string &path) {
+  std::error_code ec;
+  if (!fs::exists(path, ec)) {
+    this->_misses++;
+    return nullptr;
+  }
+  std::unique_ptr<TokenFile> res;
+  try {
+    res.reset(new TokenFile(path.c_str(), source.size()));
+  } catch (const char *) {
+    // 被别的进程淘汰或者内容损坏，当作没有命中
+    this->_misses++;
+    return nullptr;
+  }
+  // 更新修改时间，淘汰时按最近使用的顺序
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  this->_hits++;
+  return res;
+}
+
+void TokenCache::store(const std::string &path, const TokenStream &tokens,
+                       const DiagnosticBuffer *diagnostics) {
+  std::string tmp = fmt::format(
+      "{}.{}.{}.tmp", path,
+      std::hash<std::thread::id>()(std::this_thread::get_id()),
+      this->serial++);
+  // 缓存只是加速，写不进去时解析结果照样可用，不能让异常传到 Lex::parse
+  std::string error;
+  try {
+    // 只有从头解析的连续输入会命中，单词内容总能从输入中取，不用再存一份
+    TokenFile::write(tmp.c_str(), tokens, false, diagnostics);
+  } catch (const char *e) {
+    error = e;
+  } catch (const std::exception &e) {
+    error = e.what();
+  }
+  if (!error.empty()) {
+    std::error_code ec;
+    fs::remove(tmp, ec);
+    PLOGW << "can not store the token cache " << path << ": " << error;
+    return;
+  }
+  std::error_code ec;
+  uint64_t size = fs::file_size(tmp, ec);
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return;
+  }
+  if ((this->bytes += size) > this->max_bytes) {
+    this->evict();
+  }
+}
+
+void TokenCache::evict() {
+  struct Entry {
+    fs::path path;
+    fs::file_time_type time;
+    uint64_t size;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  std::error_code ec;
+  for (fs::directory_iterator it(this->dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (it->path().extension() != SUFFIX) {
+      continue;
+    }
+    std::error_code entry_ec;
+    Entry e{it->path(), it->last_write_time(entry_ec),
+            it->file_size(entry_ec)};
+    if (!entry_ec) {
+      total += e.size;
+      entries.push_back(std::move(e));
+    }
+  }
+  // 最久没用过的在前，淘汰到上限的四分之三，避免每次写入都扫描目录
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.time < b.time; });
+  uint64_t target = this->max_bytes / 4 * 3;
+  for (const Entry &e : entries) {
+    if (total <= target) {
+      break;
+    }
+    if (fs::remove(e.path, ec)) {
+      total -= e.size;
+    }
+  }
+  this->bytes = total;
+}
+
+size_t TokenCache::hits() const { return this->_hits; }
+
+size_t TokenCache::misses() const { return this->_misses; }
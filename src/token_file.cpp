@@ -0,0 +1,444 @@
+#include "token_file.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLEX_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "TokenFile assumes a little-endian host"
+#endif
+
+static const char MAGIC[4] = {'C', 'L', 'X', 'T'};
+
+static bool is_text(Token::TokenType type) {
+  return type == Token::TokenType::Ident || type == Token::TokenType::Number ||
+         type == Token::TokenType::String || type == Token::TokenType::Char;
+}
+
+static size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+static void put_varint(std::string &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// 打开文件时逐个检查过，之后解码不再检查边界
+static size_t get_varint(const uint8_t *p, size_t &pos) {
+  size_t res = 0;
+  for (size_t shift = 0;; shift += 7) {
+    uint8_t b = p[pos++];
+    res |= static_cast<size_t>(b & 0x7f) << shift;
+    if (b < 0x80) {
+      return res;
+    }
+  }
+}
+
+static size_t get_varint(const uint8_t *p, size_t size, size_t &pos) {
+  size_t res = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    if (pos >= size) {
+      throw "the token file is corrupt";
+    }
+    uint8_t b = p[pos++];
+    res |= static_cast<size_t>(b & 0x7f) << shift;
+    if (b < 0x80) {
+      return res;
+    }
+  }
+  throw "the token file is corrupt";
+}
+
+static uint32_t to_u32(size_t value) {
+  if (value > std::numeric_limits<uint32_t>::max()) {
+    throw "the input is too large for TokenFile";
+  }
+  return static_cast<uint32_t>(value);
+}
+
+static void write_section(std::ofstream &out, const void *data, size_t size) {
+  static const char zeros[8] = {};
+  out.write(static_cast<const char *>(data), size);
+  out.write(zeros, align8(size) - size);
+}
+
+void TokenFile::write(const char *path, const TokenStream &tokens,
+                      bool with_text, const DiagnosticBuffer *diagnostics) {
+  size_t count = tokens.size();
+  std::vector<uint8_t> kinds(count);
+  std::vector<uint8_t> subtypes(count);
+  std::vector<uint32_t> lengths(count);
+  std::vector<Checkpoint> checkpoints;
+  std::string offsets;
+  std::string texts;
+  size_t prev_end = 0;
+  size_t text = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t offset = tokens.offset(i);
+    kinds[i] = static_cast<uint8_t>(tokens.type(i));
+    subtypes[i] = tokens.subtype(i);
+    lengths[i] = tokens.length(i);
+    put_varint(offsets, offset - prev_end);
+    if (i % TOKEN_FILE_CHECKPOINT == 0) {
+      checkpoints.push_back(
+          Checkpoint{to_u32(offset), to_u32(offsets.size()), to_u32(text)});
+    }
+    if (is_text(tokens.type(i))) {
+      if (with_text) {
+        texts.append(tokens.text(i));
+      }
+      text += lengths[i];
+    }
+    prev_end = offset + lengths[i];
+  }
+  const std::vector<size_t> &newlines = tokens.input().lines();
+  std::vector<uint32_t> lines(newlines.size());
+  for (size_t i = 0; i < newlines.size(); i++) {
+    lines[i] = to_u32(newlines[i]);
+  }
+
+  std::vector<DiagnosticRecord> records;
+  if (diagnostics != nullptr) {
+    for (const Diagnostic &d : diagnostics->items()) {
+      records.push_back(DiagnosticRecord{static_cast<uint32_t>(d.kind),
+                                         to_u32(d.offset), to_u32(d.length),
+                                         to_u32(d.count)});
+    }
+  }
+
+  Header header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = TOKEN_FILE_VERSION;
+  header.flags = with_text ? HAS_TEXT : 0;
+  header.count = count;
+  header.lines = lines.size();
+  header.offsets_size = offsets.size();
+  header.text_size = texts.size();
+  header.diagnostics = to_u32(records.size());
+  header.dropped = diagnostics != nullptr ? diagnostics->dropped() : 0;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw "can not open the token file";
+  }
+  write_section(out, &header, sizeof(header));
+  write_section(out, kinds.data(), kinds.size());
+  write_section(out, subtypes.data(), subtypes.size());
+  write_section(out, lengths.data(), lengths.size() * sizeof(uint32_t));
+  write_section(out, lines.data(), lines.size() * sizeof(uint32_t));
+  write_section(out, checkpoints.data(),
+                checkpoints.size() * sizeof(Checkpoint));
+  write_section(out, offsets.data(), offsets.size());
+  write_section(out, texts.data(), texts.size());
+  write_section(out, records.data(), records.size() * sizeof(DiagnosticRecord));
+  if (!out) {
+    throw "can not write the token file";
+  }
+}
+
+TokenFile::TokenFile(const char *path, size_t source_size)
+    : data_(nullptr), size_(0), mapping_(nullptr) {
+  try {
+    this->map(path);
+    this->validate(source_size);
+  } catch (const char *) {
+    // 构造失败时析构函数不会执行
+#ifdef CLEX_HAS_MMAP
+    if (this->mapping_ != nullptr) {
+      munmap(this->mapping_, this->size_);
+    }
+#endif
+    throw;
+  }
+}
+
+void TokenFile::map(const char *path) {
+#ifdef CLEX_HAS_MMAP
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        this->mapping_ = p;
+        this->data_ = static_cast<const char *>(p);
+        this->size_ = st.st_size;
+      }
+    }
+    close(fd);
+  }
+#endif
+  if (this->data_ == nullptr) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      throw "can not open the token file";
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    this->buffer_ = ss.str();
+    this->data_ = this->buffer_.data();
+    this->size_ = this->buffer_.size();
+  }
+
+  if (this->size_ < sizeof(Header)) {
+    throw "the token file is truncated";
+  }
+  this->header = reinterpret_cast<const Header *>(this->data_);
+  if (memcmp(this->header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw "not a token file";
+  }
+  if (this->header->version != TOKEN_FILE_VERSION) {
+    throw "unsupported token file version";
+  }
+  // 每段都在文件之内，先排除过大的长度，下面计算段大小时不会溢出
+  if (this->header->count > this->size_ || this->header->lines > this->size_ ||
+      this->header->offsets_size > this->size_ ||
+      this->header->text_size > this->size_ ||
+      this->header->diagnostics > this->size_) {
+    throw "the token file is truncated";
+  }
+  size_t count = this->header->count;
+  size_t checkpoints =
+      (count + TOKEN_FILE_CHECKPOINT - 1) / TOKEN_FILE_CHECKPOINT;
+  size_t at = align8(sizeof(Header));
+  auto section = [&](size_t size) {
+    const char *p = this->data_ + at;
+    at += align8(size);
+    return p;
+  };
+  this->kinds = reinterpret_cast<const uint8_t *>(section(count));
+  this->subtypes = reinterpret_cast<const uint8_t *>(section(count));
+  this->lengths = reinterpret_cast<const uint32_t *>(
+      section(count * sizeof(uint32_t)));
+  this->lines = reinterpret_cast<const uint32_t *>(
+      section(this->header->lines * sizeof(uint32_t)));
+  this->checkpoints = reinterpret_cast<const Checkpoint *>(
+      section(checkpoints * sizeof(Checkpoint)));
+  this->offsets =
+      reinterpret_cast<const uint8_t *>(section(this->header->offsets_size));
+  this->texts = section(this->header->text_size);
+  this->diagnostics = reinterpret_cast<const DiagnosticRecord *>(
+      section(this->header->diagnostics * sizeof(DiagnosticRecord)));
+  if (at > this->size_) {
+    throw "the token file is truncated";
+  }
+}
+
+void TokenFile::validate(size_t source_size) const {
+  // 偏移列和长度列都是 u32
+  size_t limit = std::min<size_t>(source_size,
+                                  std::numeric_limits<uint32_t>::max());
+  size_t offset = 0;
+  size_t pos = 0;
+  size_t text = 0;
+  for (size_t i = 0; i < this->size(); i++) {
+    size_t kind = this->kinds[i];
+    if (kind >= static_cast<size_t>(Token::TokenType::Null)) {
+      throw "the token file is corrupt";
+    }
+    Token::TokenType type = this->type(i);
+    if ((type == Token::TokenType::OP && this->subtypes[i] >= OP_TYPE_COUNT) ||
+        (type == Token::TokenType::ReservedWord &&
+         this->subtypes[i] >= RESERVED_WORD_COUNT)) {
+      throw "the token file is corrupt";
+    }
+    if (i > 0) {
+      offset += this->lengths[i - 1];
+    }
+    size_t delta = get_varint(this->offsets, this->header->offsets_size, pos);
+    if (delta > limit - offset || this->lengths[i] > limit - offset - delta) {
+      throw "the token file does not match the input";
+    }
+    offset += delta;
+    if (i % TOKEN_FILE_CHECKPOINT == 0) {
+      const Checkpoint &cp = this->checkpoints[i / TOKEN_FILE_CHECKPOINT];
+      if (cp.offset != offset || cp.pos != pos || cp.text != text) {
+        throw "the token file is corrupt";
+      }
+    }
+    if (is_text(type)) {
+      text += this->lengths[i];
+    }
+  }
+  if (pos != this->header->offsets_size ||
+      (this->has_text() && text != this->header->text_size)) {
+    throw "the token file is corrupt";
+  }
+  for (size_t i = 0; i < this->header->diagnostics; i++) {
+    const DiagnosticRecord &d = this->diagnostics[i];
+    if (d.kind >= DIAGNOSTIC_KINDS || d.count == 0 || d.offset > limit ||
+        d.length > limit - d.offset) {
+      throw "the token file is corrupt";
+    }
+  }
+  for (size_t i = 0; i < this->header->lines; i++) {
+    if (this->lines[i] >= limit ||
+        (i > 0 && this->lines[i] <= this->lines[i - 1])) {
+      throw "the token file is corrupt";
+    }
+  }
+}
+
+TokenFile::~TokenFile() {
+#ifdef CLEX_HAS_MMAP
+  if (this->mapping_ != nullptr) {
+    munmap(this->mapping_, this->size_);
+  }
+#endif
+}
+
+void TokenFile::load(TokenStream &tokens) const {
+  tokens.reserve(tokens.size() + this->size());
+  size_t offset = 0;
+  size_t pos = 0;
+  for (size_t i = 0; i < this->size(); i++) {
+    offset += get_varint(this->offsets, pos);
+    tokens.push_back(this->type(i), this->subtypes[i],
+                     static_cast<uint32_t>(offset), this->lengths[i]);
+    offset += this->lengths[i];
+  }
+}
+
+void TokenFile::load_diagnostics(DiagnosticBuffer &diagnostics,
+                                 std::string_view source) const {
+  for (size_t i = 0; i < this->header->diagnostics; i++) {
+    const DiagnosticRecord &d = this->diagnostics[i];
+    diagnostics.add(static_cast<Diagnostic::Kind>(d.kind), d.offset,
+                    source.substr(d.offset, d.length), false, d.count);
+  }
+  diagnostics.drop(this->header->dropped);
+}
+
+size_t TokenFile::size() const { return this->header->count; }
+
+bool TokenFile::empty() const { return this->size() == 0; }
+
+bool TokenFile::has_text() const {
+  return (this->header->flags & HAS_TEXT) != 0;
+}
+
+void TokenFile::locate(size_t i, size_t &offset, size_t &pos,
+                       size_t &text) const {
+  // 从最近的检查点开始逐个解码
+  size_t base = i / TOKEN_FILE_CHECKPOINT * TOKEN_FILE_CHECKPOINT;
+  const Checkpoint &cp = this->checkpoints[i / TOKEN_FILE_CHECKPOINT];
+  offset = cp.offset;
+  text = cp.text;
+  pos = cp.pos;
+  for (size_t j = base; j < i; j++) {
+    if (is_text(this->type(j))) {
+      text += this->lengths[j];
+    }
+    offset += this->lengths[j] + get_varint(this->offsets, pos);
+  }
+}
+
+Token TokenFile::make(size_t i, size_t offset, size_t text) const {
+  Position pos = this->position_at(offset);
+  switch (this->type(i)) {
+  case Token::TokenType::OP:
+    return Token(static_cast<OpType>(this->subtypes[i]), pos, offset);
+  case Token::TokenType::ReservedWord:
+    return Token(static_cast<ReservedWordType>(this->subtypes[i]), pos,
+                 offset);
+  default:
+    return Token(this->type(i),
+                 this->has_text()
+                     ? std::string_view(this->texts + text, this->lengths[i])
+                     : std::string_view(),
+                 pos, offset);
+  }
+}
+
+Token TokenFile::operator[](size_t i) const {
+  size_t offset, pos, text;
+  this->locate(i, offset, pos, text);
+  return this->make(i, offset, text);
+}
+
+TokenFile::iterator TokenFile::begin() const { return iterator(this, 0); }
+
+TokenFile::iterator TokenFile::end() const {
+  return iterator(this, this->size());
+}
+
+Token::TokenType TokenFile::type(size_t i) const {
+  return static_cast<Token::TokenType>(this->kinds[i]);
+}
+
+uint8_t TokenFile::subtype(size_t i) const { return this->subtypes[i]; }
+
+uint32_t TokenFile::offset(size_t i) const {
+  size_t offset, pos, text;
+  this->locate(i, offset, pos, text);
+  return static_cast<uint32_t>(offset);
+}
+
+uint32_t TokenFile::length(size_t i) const { return this->lengths[i]; }
+
+std::string_view TokenFile::text(size_t i) const {
+  switch (this->type(i)) {
+  case Token::TokenType::OP:
+    return spelling(static_cast<OpType>(this->subtypes[i]));
+  case Token::TokenType::ReservedWord:
+    return spelling(static_cast<ReservedWordType>(this->subtypes[i]));
+  default:
+    break;
+  }
+  if (!this->has_text()) {
+    return std::string_view();
+  }
+  size_t offset, pos, text;
+  this->locate(i, offset, pos, text);
+  return std::string_view(this->texts + text, this->lengths[i]);
+}
+
+Position TokenFile::position(size_t i) const {
+  return this->position_at(this->offset(i));
+}
+
+Position TokenFile::position_at(size_t offset) const {
+  // 和 Reader::locate 相同，换行符本身算作下一行的第 0 列
+  const uint32_t *end = this->lines + this->header->lines;
+  size_t k = std::upper_bound(this->lines, end, offset) - this->lines;
+  if (k == 0) {
+    return Position{1, offset + 1};
+  }
+  return Position{k + 1, offset - this->lines[k - 1]};
+}
+
+TokenFile::iterator::iterator(const TokenFile *file, size_t index)
+    : file(file), index(index), offset(0), pos(0), text(0) {
+  if (this->index < this->file->size()) {
+    this->file->locate(this->index, this->offset, this->pos, this->text);
+  }
+}
+
+Token TokenFile::iterator::operator*() const {
+  return this->file->make(this->index, this->offset, this->text);
+}
+
+TokenFile::iterator &TokenFile::iterator::operator++() {
+  if (is_text(this->file->type(this->index))) {
+    this->text += this->file->lengths[this->index];
+  }
+  this->offset += this->file->lengths[this->index];
+  this->index++;
+  if (this->index < this->file->size()) {
+    this->offset += get_varint(this->file->offsets, this->pos);
+  }
+  return *this;
+}
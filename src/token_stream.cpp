@@ -0,0 +1,162 @@
+#include "token_stream.h"
+#include <algorithm>
+#include <limits>
+
+TokenStream::TokenStream(const Reader *reader) : reader(reader) {}
+
+void TokenStream::push_back(const Token &token) {
+  // 偏移和结尾都要能用 u32 表示
+  if (token.offset > std::numeric_limits<uint32_t>::max() ||
+      token.length() > std::numeric_limits<uint32_t>::max() - token.offset) {
+    throw "the input is too large for TokenStream";
+  }
+  uint8_t subtype = 0;
+  const char *text = nullptr;
+  switch (token.type()) {
+  case Token::TokenType::OP:
+    subtype = static_cast<uint8_t>(token.as_op());
+    break;
+  case Token::TokenType::ReservedWord:
+    subtype = static_cast<uint8_t>(token.as_reserved_word());
+    break;
+  case Token::TokenType::Ident:
+    text = token.as_ident().data();
+    break;
+  case Token::TokenType::Number:
+    text = token.as_number().data();
+    break;
+  case Token::TokenType::String:
+    text = token.as_string().data();
+    break;
+  case Token::TokenType::Char:
+    text = token.as_char().data();
+    break;
+  case Token::TokenType::Null:
+    break;
+  }
+  this->_kinds.push_back(static_cast<uint8_t>(token.type()));
+  this->_subtypes.push_back(subtype);
+  this->_offsets.push_back(static_cast<uint32_t>(token.offset));
+  this->_lengths.push_back(static_cast<uint32_t>(token.length()));
+  this->_symbols.push_back(token.symbol);
+  if (!this->reader->is_contiguous()) {
+    this->_texts.push_back(text);
+  }
+}
+
+void TokenStream::push_back(Token::TokenType type, uint8_t subtype,
+                            uint32_t offset, uint32_t length,
+                            Symbol symbol) {
+  if (length > std::numeric_limits<uint32_t>::max() - offset) {
+    throw "the input is too large for TokenStream";
+  }
+  this->_kinds.push_back(static_cast<uint8_t>(type));
+  this->_subtypes.push_back(subtype);
+  this->_offsets.push_back(offset);
+  this->_lengths.push_back(length);
+  this->_symbols.push_back(symbol);
+}
+
+void TokenStream::append(const TokenStream &other, size_t from, size_t to) {
+  this->_kinds.insert(this->_kinds.end(), other._kinds.begin() + from,
+                      other._kinds.begin() + to);
+  this->_subtypes.insert(this->_subtypes.end(), other._subtypes.begin() + from,
+                         other._subtypes.begin() + to);
+  this->_offsets.insert(this->_offsets.end(), other._offsets.begin() + from,
+                        other._offsets.begin() + to);
+  this->_lengths.insert(this->_lengths.end(), other._lengths.begin() + from,
+                        other._lengths.begin() + to);
+  this->_symbols.insert(this->_symbols.end(), other._symbols.begin() + from,
+                        other._symbols.begin() + to);
+}
+
+void TokenStream::set_symbol(size_t i, Symbol symbol) {
+  this->_symbols[i] = symbol;
+}
+
+size_t TokenStream::size() const { return this->_kinds.size(); }
+
+bool TokenStream::empty() const { return this->_kinds.empty(); }
+
+void TokenStream::reserve(size_t n) {
+  this->_kinds.reserve(n);
+  this->_subtypes.reserve(n);
+  this->_offsets.reserve(n);
+  this->_lengths.reserve(n);
+  this->_symbols.reserve(n);
+  if (!this->reader->is_contiguous()) {
+    this->_texts.reserve(n);
+  }
+}
+
+Token TokenStream::operator[](size_t i) const {
+  Position pos = this->position(i);
+  size_t offset = this->_offsets[i];
+  switch (this->type(i)) {
+  case Token::TokenType::OP:
+    return Token(static_cast<OpType>(this->_subtypes[i]), pos, offset);
+  case Token::TokenType::ReservedWord:
+    return Token(static_cast<ReservedWordType>(this->_subtypes[i]), pos,
+                 offset);
+  default: {
+    Token res(this->type(i), this->text(i), pos, offset);
+    res.symbol = this->_symbols[i];
+    return res;
+  }
+  }
+}
+
+Token TokenStream::back() const { return (*this)[this->size() - 1]; }
+
+TokenStream::iterator TokenStream::begin() const { return iterator(this, 0); }
+
+TokenStream::iterator TokenStream::end() const {
+  return iterator(this, this->size());
+}
+
+Token::TokenType TokenStream::type(size_t i) const {
+  return static_cast<Token::TokenType>(this->_kinds[i]);
+}
+
+uint8_t TokenStream::subtype(size_t i) const { return this->_subtypes[i]; }
+
+uint32_t TokenStream::offset(size_t i) const { return this->_offsets[i]; }
+
+uint32_t TokenStream::length(size_t i) const { return this->_lengths[i]; }
+
+Symbol TokenStream::symbol(size_t i) const { return this->_symbols[i]; }
+
+size_t TokenStream::lower_bound(size_t offset) const {
+  return std::lower_bound(this->_offsets.begin(), this->_offsets.end(),
+                          offset) -
+         this->_offsets.begin();
+}
+
+std::string_view TokenStream::text(size_t i) const {
+  switch (this->type(i)) {
+  case Token::TokenType::OP:
+    return spelling(static_cast<OpType>(this->_subtypes[i]));
+  case Token::TokenType::ReservedWord:
+    return spelling(static_cast<ReservedWordType>(this->_subtypes[i]));
+  default:
+    break;
+  }
+  if (this->reader->is_contiguous()) {
+    return this->reader->source().substr(this->_offsets[i], this->_lengths[i]);
+  }
+  return std::string_view(this->_texts[i], this->_lengths[i]);
+}
+
+Position TokenStream::position(size_t i) const {
+  return this->reader->locate(this->_offsets[i]);
+}
+
+const Reader &TokenStream::input() const { return *this->reader; }
+
+size_t TokenStream::memory() const {
+  return this->_kinds.capacity() + this->_subtypes.capacity() +
+         this->_offsets.capacity() * sizeof(uint32_t) +
+         this->_lengths.capacity() * sizeof(uint32_t) +
+         this->_symbols.capacity() * sizeof(Symbol) +
+         this->_texts.capacity() * sizeof(const char *);
+}
@@ -0,0 +1,64 @@
+#include "trace.h"
+#include <iterator>
+#include <utility>
+
+TraceSink::TraceSink(std::FILE *out, size_t buffer_size)
+    : out(out), capacity(buffer_size), stopping(false) {
+  this->current.reserve(this->capacity);
+  this->pending.reserve(this->capacity);
+  this->writer = std::thread([this] { this->run(); });
+}
+
+TraceSink::~TraceSink() {
+  this->flush();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->work_cv.notify_one();
+  this->writer.join();
+}
+
+void TraceSink::write(const Token &token) {
+  fmt::format_to(std::back_inserter(this->current), "{:d}\n", token);
+  if (this->current.size() >= this->capacity) {
+    this->hand_off();
+  }
+}
+
+void TraceSink::flush() {
+  this->hand_off();
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->idle_cv.wait(lock, [this] { return this->pending.empty(); });
+  std::fflush(this->out);
+}
+
+void TraceSink::hand_off() {
+  if (this->current.empty()) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->idle_cv.wait(lock, [this] { return this->pending.empty(); });
+    // 交换之后 current 拿到上一块已经清空的内存，不用重新分配
+    std::swap(this->current, this->pending);
+  }
+  this->work_cv.notify_one();
+}
+
+void TraceSink::run() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (true) {
+    this->work_cv.wait(
+        lock, [this] { return this->stopping || !this->pending.empty(); });
+    if (this->pending.empty()) {
+      return;
+    }
+    // pending 不为空时解析线程不会碰它，写出时不用持有锁
+    lock.unlock();
+    std::fwrite(this->pending.data(), 1, this->pending.size(), this->out);
+    lock.lock();
+    this->pending.clear();
+    this->idle_cv.notify_all();
+  }
+}
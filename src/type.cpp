@@ -1,20 +1,24 @@
 #include "type.h"
+#include "keyword.h"
+#include "op.h"
 #include <string>
 
-Token::Token(OpType op_type, Position pos)
-    : p_token(pos), token_type(TokenType::OP) {
+Token::Token(OpType op_type, Position pos, size_t offset)
+    : p_token(pos), offset(offset), token_type(TokenType::OP) {
   token_value.op_type = op_type;
 }
 
-Token::Token(ReservedWordType reserved_word, Position pos)
-    : p_token(pos), token_type(TokenType::ReservedWord) {
+Token::Token(ReservedWordType reserved_word, Position pos, size_t offset)
+    : p_token(pos), offset(offset), token_type(TokenType::ReservedWord) {
 
   token_value.reserved_word = reserved_word;
 }
 
-Token::Token(Token::TokenType type, char *data, Position pos)
-    : p_token(pos), token_type(type) {
-  token_value.data = data;
+Token::Token(Token::TokenType type, std::string_view text, Position pos,
+             size_t offset)
+    : p_token(pos), offset(offset), token_type(type) {
+  token_value.text.data = text.data();
+  token_value.text.size = text.size();
 }
 
 bool Token::is_op() const { return this->token_type == TokenType::OP; }
@@ -47,32 +51,36 @@ ReservedWordType Token::as_reserved_word() const {
   return this->token_value.reserved_word;
 }
 
-char *Token::as_ident() const {
+std::string_view Token::as_ident() const {
   if (!this->is_ident()) {
     throw "the token is not ident";
   }
-  return this->token_value.data;
+  return std::string_view(this->token_value.text.data,
+                          this->token_value.text.size);
 }
 
-char *Token::as_number() const {
+std::string_view Token::as_number() const {
   if (!this->is_number()) {
     throw "the token is not number";
   }
-  return this->token_value.data;
+  return std::string_view(this->token_value.text.data,
+                          this->token_value.text.size);
 }
 
-char *Token::as_string() const {
+std::string_view Token::as_string() const {
   if (!this->is_string()) {
     throw "the token is not string";
   }
-  return this->token_value.data;
+  return std::string_view(this->token_value.text.data,
+                          this->token_value.text.size);
 }
 
-char *Token::as_char() const {
+std::string_view Token::as_char() const {
   if (!this->is_char()) {
     throw "the token is not char";
   }
-  return this->token_value.data;
+  return std::string_view(this->token_value.text.data,
+                          this->token_value.text.size);
 }
 
 namespace plog {
@@ -187,3 +195,24 @@ Record &operator<<(Record &record, const Token &t) {
 } // namespace plog
 
 Token::TokenType Token::type() const { return this->token_type; }
+
+size_t Token::length() const {
+  switch (this->token_type) {
+  case TokenType::OP:
+    return spelling(this->token_value.op_type).size();
+  case TokenType::ReservedWord:
+    return spelling(this->token_value.reserved_word).size();
+  case TokenType::Null:
+    return 0;
+  default:
+    return this->token_value.text.size;
+  }
+}
+
+std::string_view spelling(OpType op_type) {
+  return op::entries[static_cast<size_t>(op_type)].name;
+}
+
+std::string_view spelling(ReservedWordType reserved_word) {
+  return keyword::entries[static_cast<size_t>(reserved_word)].name;
+}
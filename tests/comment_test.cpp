@@ -0,0 +1,61 @@
+#include "doctest.h"
+#include "support.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 注释之间的标识符依次是 x0, x1, ...
+static const char *COMMENTS = "/* a **/ x0\n"
+                              "/***/x1\n"
+                              "/* ** * / **/x2\n"
+                              "/*/ */x3\n"
+                              "// line \\\n still comment\nx4\n"
+                              "// crlf \\\r\n still comment\r\nx5\n"
+                              "#define A 1 \\\n  + 2 \\\n  + 3\nx6\n"
+                              "#include <a.h> // x\nx7 // end \\";
+
+static std::vector<std::string> idents(const test::Lexed &lexed) {
+  std::vector<std::string> res;
+  for (const test::Item &item : lexed.tokens) {
+    res.push_back(item.text);
+  }
+  return res;
+}
+
+static const std::vector<std::string> EXPECTED = {"x0", "x1", "x2", "x3",
+                                                  "x4", "x5", "x6", "x7"};
+
+TEST_CASE("comment endings in contiguous mode") {
+  test::Lexed lexed = test::lex_memory(COMMENTS);
+  CHECK(idents(lexed) == EXPECTED);
+  CHECK(lexed.diagnostics.empty());
+}
+
+TEST_CASE("comment endings in ring-buffer mode") {
+  test::Lexed lexed = test::lex_stream(COMMENTS);
+  CHECK(idents(lexed) == EXPECTED);
+  CHECK(lexed.diagnostics.empty());
+  CHECK(lexed.tokens == test::lex_memory(COMMENTS).tokens);
+}
+
+TEST_CASE("comment endings across the ring buffer halves") {
+  // 环形缓冲每半块 1024 字节，逐字节移动输入，让每个注释结尾都落在交界处一次
+  size_t length = std::strlen(COMMENTS);
+  for (size_t base : {1024, 2048}) {
+    for (size_t pad = base - length; pad <= base; pad++) {
+      std::string source = std::string(pad, ' ') + COMMENTS;
+      CAPTURE(pad);
+      test::Lexed memory = test::lex_memory(source);
+      test::Lexed stream = test::lex_stream(source);
+      CHECK(idents(stream) == EXPECTED);
+      CHECK(stream.tokens == memory.tokens);
+    }
+  }
+}
+
+TEST_CASE("unterminated block comments run to the end of input") {
+  const char *source = "x0 /* never closed *";
+  std::vector<std::string> expected = {"x0"};
+  CHECK(idents(test::lex_memory(source)) == expected);
+  CHECK(idents(test::lex_stream(source)) == expected);
+}
@@ -0,0 +1,5 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+// This is all that is needed to compile a test-runner executable.
+// More tests can be added here, or in a new tests/*.cpp file.
@@ -0,0 +1,104 @@
+#include "doctest.h"
+#include "number.h"
+#include "support.h"
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+// 状态机替换之前 Lex::parse_number 使用的正则
+static bool number_regex(const std::string &text) {
+  static const std::regex re(
+      "^(\\-|\\+)?(0|(((\\d*\\.\\d+)|(\\d+\\.\\d*))(e(\\+|\\-)?\\d+)?)|([1-9]"
+      "\\d*)|(0[1-"
+      "7][0-7]*)|(0x[1-9a-f][0-9a-f]*)|(0x([1-9a-f][0-9a-f]*\\.[0-9a-f]*|["
+      "0-9a-f]*\\.[1-9a-f][0-9a-f]*)p(\\+|\\-)?[0-9a-f]+))(ul|lu|l|u)?$");
+  return std::regex_match(text, re);
+}
+
+// 逐个字符走状态机，和 Reader 非连续模式下的用法相同
+static bool number_steps(const std::string &text) {
+  number::State state = number::START;
+  for (char c : text) {
+    state = number::step(state, c);
+  }
+  return number::accept(state);
+}
+
+static const std::vector<std::string> LITERALS = {
+    // 十六进制浮点数
+    "0x1.8p3", "0x1.p3", "0x.8p3", "0x.8p-1", "0x1.8p+a", "0xa.bp1f",
+    "0x0.0p1", "0x0.1p1", "0x1p3", "0x1.8", "0x1.8p", "0x.p1", "0x1.8p3u",
+    "0x1.8p3ul", "0x1.8p3x", "0X1.8p3",
+    // 后缀
+    "1u", "1l", "1ul", "1lu", "1uu", "1ll", "1ull", "1lul", "1U", "1L",
+    "0u", "07l", "0x1fu", "1.5u", "1.5e3l", "1ux",
+    // 八进制
+    "0", "00", "01", "07", "017", "0177", "08", "018", "0109", "01.5",
+    "010", "0017",
+    // 十进制和指数
+    "1", "10", "1.", ".5", "1.5", "1e5", "1.e5", "1.5e+5", "1.5e-5",
+    "1.5e", "1e", ".", "..", "1..2", "-1", "+1.5", "--1", "0x", "0x0",
+    "0x10", "0xff", "0xg"};
+
+TEST_CASE("the number DFA agrees with the regex on literals") {
+  for (const std::string &text : LITERALS) {
+    CAPTURE(text);
+    bool expected = number_regex(text);
+    CHECK(number::is_valid(text) == expected);
+    CHECK(number_steps(text) == expected);
+  }
+}
+
+TEST_CASE("the number DFA agrees with the regex on all short strings") {
+  // 覆盖每个状态在这些字符上的转移
+  const std::string alphabet = "0178ax.pe+-ulz";
+  std::vector<std::string> level = {""};
+  for (size_t len = 1; len <= 4; len++) {
+    std::vector<std::string> next;
+    for (const std::string &prefix : level) {
+      for (char c : alphabet) {
+        std::string text = prefix + c;
+        bool expected = number_regex(text);
+        if (number::is_valid(text) != expected ||
+            number_steps(text) != expected) {
+          CAPTURE(text);
+          CHECK(number::is_valid(text) == expected);
+          CHECK(number_steps(text) == expected);
+        }
+        next.push_back(text);
+      }
+    }
+    level.swap(next);
+  }
+}
+
+TEST_CASE("numbers lex the same way in contiguous and ring-buffer mode") {
+  std::string source;
+  for (const std::string &text : LITERALS) {
+    source += text;
+    source += " ;\n";
+  }
+  test::Lexed memory = test::lex_memory(source);
+  test::Lexed stream = test::lex_stream(source);
+  CHECK(memory.tokens == stream.tokens);
+  CHECK(memory.diagnostics == stream.diagnostics);
+
+  // 数字 Token 只有在正则拒绝时才报告 BadNumber
+  std::set<std::string> bad;
+  for (const test::Issue &issue : memory.diagnostics) {
+    if (issue.kind == Diagnostic::Kind::BadNumber) {
+      bad.insert(issue.text);
+    }
+  }
+  size_t numbers = 0;
+  for (const test::Item &item : memory.tokens) {
+    if (item.type != Token::TokenType::Number) {
+      continue;
+    }
+    numbers++;
+    CAPTURE(item.text);
+    CHECK((bad.count(item.text) == 0) == number_regex(item.text));
+  }
+  CHECK(numbers > LITERALS.size() / 2);
+}
@@ -0,0 +1,108 @@
+#include "doctest.h"
+#include "lex.h"
+#include "support.h"
+#include <string>
+
+// 普通的代码行，标识符各不相同；错误的数字有几百种，每种重复多次
+static std::string filler(size_t n) {
+  switch (n % 4) {
+  case 0:
+    return "int v" + std::to_string(n) + " = f" + std::to_string(n % 13) +
+           "(a, b) + 0x1f;\n";
+  case 1:
+    return "s = \"text\"; c = 'c'; x >>= 2;\n";
+  case 2:
+    // 0 开头的数字里带 9
+    return "y" + std::to_string(n % 7) + " = 0" +
+           std::to_string(n / 4 % 400) + "9;\n";
+  default:
+    return "/* short */ if (p->q != 1.5e3) { return; }\n";
+  }
+}
+
+// 跨过切点的写法，切点落在 head 之后的第一个换行上
+static const char *HEADS[] = {"/* comment ** head", "s = \"string head \\",
+                              "#define M(x) macro head \\"};
+// 注释里的引号让从切点开始的推测解析把注释之后的代码当成字符串，
+// 拼接时要从注释结尾重新解析，并带上其中 09 的诊断
+static const char *TAILS[] = {"\n still \"comment */ x = 09;\n",
+                              "\n string tail\"; y = 2;\n",
+                              "\n  (x) + 1 \\\n  + 2\nz = 3;\n"};
+
+/**
+   按 Lex::parse_parallel 的规则构造输入：第 i 个切点是 size / threads * i
+   之后的第一个换行，这个换行放在块注释、字符串或续行的宏中间
+ */
+static std::string build(size_t size, size_t threads) {
+  std::string source;
+  size_t line = 0;
+  for (size_t i = 1; i < threads; i++) {
+    size_t at = size / threads * i;
+    while (source.size() + 128 < at) {
+      source += filler(line++);
+    }
+    // head 的结尾紧挨着换行，反斜杠才算续行
+    std::string head = HEADS[i % 3];
+    source.append(at + 1 - head.size() - source.size(), ' ');
+    source += head;
+    source += TAILS[i % 3];
+  }
+  while (source.size() + 128 < size) {
+    source += filler(line++);
+  }
+  source.append(size - source.size(), ' ');
+  return source;
+}
+
+static test::Lexed lex_serial(const std::string &source) {
+  Lex lex{std::string_view(source)};
+  lex.parse();
+  return test::collect(lex);
+}
+
+static test::Lexed lex_parallel(const std::string &source, size_t threads) {
+  Lex lex{std::string_view(source)};
+  lex.parse_parallel(threads);
+  return test::collect(lex);
+}
+
+TEST_CASE("parse_parallel matches parse when chunks split comments, strings "
+          "and macros") {
+  for (size_t threads : {2, 4, 7}) {
+    size_t size = threads * PARALLEL_MIN_CHUNK + 4096;
+    std::string source = build(size, threads);
+    REQUIRE(source.size() == size);
+    CAPTURE(threads);
+    test::Lexed serial = lex_serial(source);
+    test::Lexed parallel = lex_parallel(source, threads);
+    CHECK(parallel.tokens.size() == serial.tokens.size());
+    CHECK(parallel.tokens == serial.tokens);
+    CHECK(parallel.symbols == serial.symbols);
+    CHECK(parallel.diagnostics == serial.diagnostics);
+    CHECK(parallel.dropped == serial.dropped);
+    // 诊断没有超过上限，逐条比较位置和重复次数
+    CHECK(serial.dropped == 0);
+    CHECK(serial.diagnostics.size() > 400);
+  }
+}
+
+TEST_CASE("parse_parallel matches parse when a chunk starts inside a long "
+          "comment") {
+  // 一个块注释跨过好几个切点，中间的分块没有一个 Token 能对齐
+  size_t threads = 4;
+  std::string source = "a = 1; /*\n";
+  while (source.size() < PARALLEL_MIN_CHUNK * 3) {
+    source += "  int in_comment = \"x\"; // \\\n";
+  }
+  source += "*/ b = 2;\n";
+  for (size_t line = 0; source.size() < threads * PARALLEL_MIN_CHUNK + 4096;
+       line++) {
+    source += filler(line);
+  }
+  test::Lexed serial = lex_serial(source);
+  test::Lexed parallel = lex_parallel(source, threads);
+  CHECK(parallel.tokens == serial.tokens);
+  CHECK(parallel.symbols == serial.symbols);
+  CHECK(parallel.diagnostics == serial.diagnostics);
+  CHECK(parallel.dropped == serial.dropped);
+}
@@ -0,0 +1,118 @@
+#include "doctest.h"
+#include "lex.h"
+#include "support.h"
+#include <string>
+#include <vector>
+
+static const std::string SOURCE = "int main(void) {\n"
+                                  "  int a = 1; /* one */\n"
+                                  "  char *s = \"text\";\n"
+                                  "  // note\n"
+                                  "  return a + 0x1f;\n"
+                                  "}\n";
+
+struct Case {
+  const char *name;
+  size_t offset;
+  size_t removed;
+  std::string inserted;
+};
+
+// 不比较行列，旧 Token 的位置按修改前的输入计算
+static test::Item item(const Token &token, std::string_view text) {
+  uint8_t subtype = 0;
+  if (token.is_op()) {
+    subtype = static_cast<uint8_t>(token.as_op());
+  } else if (token.is_reserved_word()) {
+    subtype = static_cast<uint8_t>(token.as_reserved_word());
+  }
+  return test::Item{token.type(),  subtype, token.offset,
+                    token.length(), std::string(text), 0, 0};
+}
+
+static std::vector<test::Item> strip(std::vector<test::Item> items) {
+  for (test::Item &i : items) {
+    i.row = 0;
+    i.col = 0;
+  }
+  return items;
+}
+
+// 把 diff 应用到修改前的 Token 序列上
+static std::vector<test::Item> apply(const TokenStream &old,
+                                     const TokenDiff &diff,
+                                     std::string_view source) {
+  std::vector<test::Item> before = strip(test::items(old));
+  std::vector<test::Item> res(before.begin(), before.begin() + diff.first);
+  for (const Token &token : diff.inserted) {
+    res.push_back(item(token, source.substr(token.offset, token.length())));
+  }
+  for (size_t i = diff.first + diff.removed; i < before.size(); i++) {
+    test::Item moved = before[i];
+    moved.offset += diff.delta;
+    res.push_back(moved);
+  }
+  return res;
+}
+
+static void check_relex(const Case &c) {
+  CAPTURE(c.name);
+  std::string edited = SOURCE.substr(0, c.offset) + c.inserted +
+                       SOURCE.substr(c.offset + c.removed);
+  Lex old{std::string_view(SOURCE)};
+  old.parse();
+  TokenDiff diff = Lex::relex(edited, old.tokens(),
+                              Edit{c.offset, c.removed, c.inserted.size()});
+  CHECK(diff.delta == static_cast<std::ptrdiff_t>(c.inserted.size()) -
+                          static_cast<std::ptrdiff_t>(c.removed));
+  CHECK(apply(old.tokens(), diff, edited) ==
+        strip(test::lex_memory(edited).tokens));
+}
+
+static size_t at(const char *text) { return SOURCE.find(text); }
+
+TEST_CASE("relex inserts at the start, middle and end") {
+  check_relex({"start", 0, 0, "static "});
+  check_relex({"middle", at("1;"), 0, "10 + "});
+  check_relex({"end", SOURCE.size(), 0, "int b;\n"});
+  check_relex({"inside a token", at("main") + 2, 0, "x"});
+}
+
+TEST_CASE("relex deletes at the start, middle and end") {
+  check_relex({"start", 0, 4, ""});
+  check_relex({"middle", at("/* one */"), 9, ""});
+  check_relex({"end", at("}\n"), 2, ""});
+  check_relex({"everything", 0, SOURCE.size(), ""});
+}
+
+TEST_CASE("relex replaces at the start, middle and end") {
+  check_relex({"start", 0, 3, "long"});
+  check_relex({"middle", at("text"), 4, "te\\\"xt"});
+  check_relex({"end", at("}\n"), 2, "} // done\n"});
+  check_relex({"bad number", at("0x1f"), 4, "09"});
+  // 新插入的 b 换算回修改前正好是 a 的偏移，不能在插入的内容中对齐
+  check_relex({"shorter", at("int a"), 6, "b "});
+  check_relex({"longer", at("a = 1"), 1, "a = 1; int c"});
+}
+
+TEST_CASE("relex follows edits that change the lexer state") {
+  // 打开或关闭注释、字符串会影响修改处之后的 Token，要一直解析到重新对齐
+  check_relex({"open comment", at("char"), 0, "/* "});
+  check_relex({"close comment", at("one */") + 4, 2, ""});
+  check_relex({"open string", at("a + 0x1f"), 0, "\""});
+  check_relex({"line comment", at("int a"), 0, "// "});
+  check_relex({"splice line comment", at("note") + 4, 0, " \\"});
+}
+
+TEST_CASE("relex reports diagnostics in the relexed range") {
+  std::string edited = SOURCE;
+  size_t offset = at("0x1f");
+  edited.replace(offset, 4, "09");
+  Lex old{std::string_view(SOURCE)};
+  old.parse();
+  TokenDiff diff = Lex::relex(edited, old.tokens(), Edit{offset, 4, 2});
+  REQUIRE(diff.diagnostics.size() == 1);
+  CHECK(diff.diagnostics[0].kind == Diagnostic::Kind::BadNumber);
+  CHECK(diff.diagnostics[0].offset == offset);
+  CHECK(diff.diagnostics[0].text == "09");
+}
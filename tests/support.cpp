@@ -0,0 +1,128 @@
+#include "support.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLEX_TEST_PIPE 1
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace test {
+
+bool Item::operator==(const Item &other) const {
+  return this->type == other.type && this->subtype == other.subtype &&
+         this->offset == other.offset && this->length == other.length &&
+         this->text == other.text && this->row == other.row &&
+         this->col == other.col;
+}
+
+bool Issue::operator==(const Issue &other) const {
+  return this->kind == other.kind && this->offset == other.offset &&
+         this->length == other.length && this->text == other.text &&
+         this->count == other.count;
+}
+
+std::ostream &operator<<(std::ostream &out, const Item &item) {
+  return out << "{type " << static_cast<int>(item.type) << ", subtype "
+             << static_cast<int>(item.subtype) << ", offset " << item.offset
+             << ", length " << item.length << ", '" << item.text << "' at "
+             << item.row << ":" << item.col << "}";
+}
+
+std::ostream &operator<<(std::ostream &out, const Issue &issue) {
+  return out << "{kind " << static_cast<int>(issue.kind) << ", offset "
+             << issue.offset << ", length " << issue.length << ", '"
+             << issue.text << "' x" << issue.count << "}";
+}
+
+std::vector<Item> items(const TokenStream &tokens) {
+  std::vector<Item> res;
+  res.reserve(tokens.size());
+  for (size_t i = 0; i < tokens.size(); i++) {
+    Position pos = tokens.position(i);
+    res.push_back(Item{tokens.type(i), tokens.subtype(i), tokens.offset(i),
+                       tokens.length(i), std::string(tokens.text(i)), pos.row,
+                       pos.col});
+  }
+  return res;
+}
+
+Lexed collect(const Lex &lex) {
+  Lexed res;
+  const TokenStream &tokens = lex.tokens();
+  res.tokens = items(tokens);
+  for (size_t i = 0; i < tokens.size(); i++) {
+    res.symbols.push_back(tokens.symbol(i));
+  }
+  for (const Diagnostic &d : lex.diagnostics()) {
+    res.diagnostics.push_back(
+        Issue{d.kind, d.offset, d.length, std::string(d.text), d.count});
+  }
+  res.dropped = lex.dropped_diagnostics();
+  return res;
+}
+
+Lexed lex_memory(std::string_view source) {
+  Lex lex(source);
+  lex.parse();
+  return collect(lex);
+}
+
+#ifdef CLEX_TEST_PIPE
+Lexed lex_stream(std::string_view source) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    throw "can not create pipe";
+  }
+  // 另开线程写入，输入比管道的缓冲大时不会互相等待
+  std::thread writer([&source, fds] {
+    size_t done = 0;
+    while (done < source.size()) {
+      ssize_t n = write(fds[1], source.data() + done, source.size() - done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        break;
+      }
+      done += n;
+    }
+    close(fds[1]);
+  });
+  Lexed res;
+  {
+    std::string path = "/dev/fd/" + std::to_string(fds[0]);
+    Lex lex(path.c_str());
+    lex.parse();
+    res = collect(lex);
+  }
+  writer.join();
+  close(fds[0]);
+  return res;
+}
+#else
+Lexed lex_stream(std::string_view source) {
+  std::string path = temp_path("clex_stream_test.c");
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(source.data(), source.size());
+  }
+  Lexed res;
+  {
+    Lex lex(path.c_str());
+    lex.parse();
+    res = collect(lex);
+  }
+  std::remove(path.c_str());
+  return res;
+}
+#endif
+
+std::string temp_path(const char *name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+} // namespace test
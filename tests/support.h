@@ -0,0 +1,78 @@
+#pragma once
+#include "diagnostic.h"
+#include "lex.h"
+#include "type.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+   测试共用的工具：把 Lex 的结果复制成和输入无关的值，便于在不同的解析方式之间比较
+ */
+namespace test {
+
+// 一个 Token 的各列、单词内容和行列
+struct Item {
+  Token::TokenType type;
+  uint8_t subtype;
+  size_t offset;
+  size_t length;
+  std::string text;
+  size_t row;
+  size_t col;
+
+  bool operator==(const Item &other) const;
+  bool operator!=(const Item &other) const { return !(*this == other); }
+};
+
+// 一条诊断，单词内容复制出来
+struct Issue {
+  Diagnostic::Kind kind;
+  size_t offset;
+  size_t length;
+  std::string text;
+  size_t count;
+
+  bool operator==(const Issue &other) const;
+  bool operator!=(const Issue &other) const { return !(*this == other); }
+};
+
+std::ostream &operator<<(std::ostream &out, const Item &item);
+
+std::ostream &operator<<(std::ostream &out, const Issue &issue);
+
+/**
+   一次解析的全部结果
+ */
+struct Lexed {
+  std::vector<Item> tokens;
+  // 每个 Token 的符号编号
+  std::vector<Symbol> symbols;
+  std::vector<Issue> diagnostics;
+  size_t dropped = 0;
+};
+
+std::vector<Item> items(const TokenStream &tokens);
+
+Lexed collect(const Lex &lex);
+
+/**
+   用 Lex(std::string_view) 解析，走 Reader 的连续模式
+ */
+Lexed lex_memory(std::string_view source);
+
+/**
+   通过管道交给 Lex(path) 解析，走 Reader 的环形缓冲
+   没有管道的平台写到临时文件，由 ifstream 读入，同样是环形缓冲
+ */
+Lexed lex_stream(std::string_view source);
+
+/**
+   临时目录下的路径，name 在各个测试之间不要重复
+ */
+std::string temp_path(const char *name);
+
+} // namespace test
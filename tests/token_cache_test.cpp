@@ -0,0 +1,38 @@
+#include "doctest.h"
+#include "lex.h"
+#include "support.h"
+#include "token_cache.h"
+#include <filesystem>
+#include <string>
+
+TEST_CASE("TokenCache hits return the same tokens and diagnostics") {
+  std::string dir = test::temp_path("clex_token_cache_test");
+  std::filesystem::remove_all(dir);
+  std::string source = "int main(void) {\n"
+                       "  int a = 09; /* bad number */\n"
+                       "  return a + 'ab';\n"
+                       "}\n";
+  TokenCache cache(dir);
+
+  Lex miss{std::string_view(source)};
+  miss.set_cache(&cache);
+  miss.parse();
+  CHECK(cache.misses() == 1);
+
+  Lex hit{std::string_view(source)};
+  hit.set_cache(&cache);
+  hit.parse();
+  CHECK(cache.hits() == 1);
+
+  test::Lexed expected = test::collect(miss);
+  test::Lexed cached = test::collect(hit);
+  CHECK(cached.tokens == expected.tokens);
+  CHECK(cached.symbols == expected.symbols);
+  CHECK(cached.diagnostics == expected.diagnostics);
+  CHECK(expected.diagnostics.size() == 2);
+
+  // 命中时单词内容从输入中取，缓存里不存
+  TokenFile file(cache.key(source).c_str(), source.size());
+  CHECK_FALSE(file.has_text());
+  std::filesystem::remove_all(dir);
+}
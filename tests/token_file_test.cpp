@@ -0,0 +1,285 @@
+#include "diagnostic.h"
+#include "doctest.h"
+#include "lex.h"
+#include "support.h"
+#include "token_file.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 足够多的 Token，跨过好几个检查点，并带有几种诊断
+static std::string make_source() {
+  std::string source = "#include <stdio.h>\n";
+  for (int i = 0; i < 40; i++) {
+    source += "int f" + std::to_string(i) + "(char *s) { return s[" +
+              std::to_string(i) + "] + 'c' + 0x1f; }\n";
+  }
+  source += "double d = 09 + 1.5e3; /* bad number */\n";
+  source += "char *u = \"unterminated\n";
+  source += "char c = 'ab';\n";
+  return source;
+}
+
+static std::string read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+static void write_file(const std::string &path, const std::string &data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+}
+
+// 把 lex 的结果写成 Token 文件，诊断一起保存
+static void save(const std::string &path, const Lex &lex, bool with_text) {
+  DiagnosticBuffer diagnostics;
+  for (const Diagnostic &d : lex.diagnostics()) {
+    diagnostics.add(d.kind, d.offset, d.text, false, d.count);
+  }
+  TokenFile::write(path.c_str(), lex.tokens(), with_text, &diagnostics);
+}
+
+static size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+/**
+   按 TokenFile 的布局计算各段在文件中的位置
+ */
+struct Layout {
+  size_t kinds, subtypes, lengths, lines, checkpoints, offsets, texts,
+      diagnostics;
+
+  explicit Layout(const std::string &data) {
+    TokenFile::Header header;
+    memcpy(&header, data.data(), sizeof(header));
+    size_t count = header.count;
+    size_t checkpoints_count =
+        (count + TOKEN_FILE_CHECKPOINT - 1) / TOKEN_FILE_CHECKPOINT;
+    this->kinds = align8(sizeof(header));
+    this->subtypes = this->kinds + align8(count);
+    this->lengths = this->subtypes + align8(count);
+    this->lines = this->lengths + align8(count * sizeof(uint32_t));
+    this->checkpoints = this->lines + align8(header.lines * sizeof(uint32_t));
+    this->offsets = this->checkpoints +
+                    align8(checkpoints_count * sizeof(TokenFile::Checkpoint));
+    this->texts = this->offsets + align8(header.offsets_size);
+    this->diagnostics = this->texts + align8(header.text_size);
+  }
+};
+
+template <typename T>
+static void patch(std::string &data, size_t at, const T &value) {
+  memcpy(&data[at], &value, sizeof(value));
+}
+
+static std::vector<test::Item> file_items(const TokenFile &file) {
+  std::vector<test::Item> res;
+  for (size_t i = 0; i < file.size(); i++) {
+    Position pos = file.position(i);
+    res.push_back(test::Item{file.type(i), file.subtype(i), file.offset(i),
+                             file.length(i), std::string(file.text(i)),
+                             pos.row, pos.col});
+  }
+  return res;
+}
+
+// 打开后访问每个 Token，损坏的文件要么打开时被拒绝，要么所有访问都在文件之内
+static void read_all(const std::string &path, const std::string &source) {
+  TokenFile file(path.c_str(), source.size());
+  file_items(file);
+  for (Token token : file) {
+    (void)token;
+  }
+  Reader reader{std::string_view(source)};
+  TokenStream tokens(&reader);
+  file.load(tokens);
+  test::items(tokens);
+  DiagnosticBuffer diagnostics;
+  file.load_diagnostics(diagnostics, source);
+}
+
+TEST_CASE("TokenFile round-trips a token stream") {
+  std::string source = make_source();
+  std::string path = test::temp_path("clex_token_file_test.tok");
+  Lex lex{std::string_view(source)};
+  lex.parse();
+  REQUIRE(lex.tokens().size() > 3 * TOKEN_FILE_CHECKPOINT);
+  REQUIRE(lex.diagnostics().size() >= 3);
+  std::vector<test::Item> expected = test::items(lex.tokens());
+
+  for (bool with_text : {true, false}) {
+    CAPTURE(with_text);
+    save(path, lex, with_text);
+    TokenFile file(path.c_str(), source.size());
+    CHECK(file.has_text() == with_text);
+    REQUIRE(file.size() == expected.size());
+
+    if (with_text) {
+      // 随机访问从检查点解码，顺序访问逐个解码，结果都和解析时相同
+      CHECK(file_items(file) == expected);
+      size_t i = 0;
+      for (Token token : file) {
+        CHECK(token.offset == expected[i].offset);
+        CHECK(token.length() == expected[i].length);
+        CHECK(token.p_token.row == expected[i].row);
+        i++;
+      }
+      CHECK(i == expected.size());
+    } else {
+      CHECK(file.text(1).empty());
+    }
+
+    // 读回到同一段输入上，单词内容从输入中取
+    Reader reader{std::string_view(source)};
+    TokenStream tokens(&reader);
+    file.load(tokens);
+    CHECK(test::items(tokens) == expected);
+
+    DiagnosticBuffer diagnostics;
+    file.load_diagnostics(diagnostics, source);
+    std::vector<test::Issue> loaded;
+    for (const Diagnostic &d : diagnostics.items()) {
+      loaded.push_back(test::Issue{d.kind, d.offset, d.length,
+                                   std::string(d.text), d.count});
+    }
+    CHECK(loaded == test::collect(lex).diagnostics);
+  }
+  std::remove(path.c_str());
+}
+
+TEST_CASE("TokenFile rejects truncated files") {
+  std::string source = make_source();
+  std::string path = test::temp_path("clex_token_file_test.tok");
+  Lex lex{std::string_view(source)};
+  lex.parse();
+  save(path, lex, true);
+  std::string data = read_file(path);
+  Layout layout(data);
+  std::vector<size_t> sizes = {0,
+                               8,
+                               sizeof(TokenFile::Header) - 1,
+                               sizeof(TokenFile::Header),
+                               layout.lengths,
+                               layout.offsets + 1,
+                               layout.diagnostics,
+                               data.size() - 1};
+  for (size_t size : sizes) {
+    CAPTURE(size);
+    write_file(path, data.substr(0, size));
+    CHECK_THROWS(TokenFile(path.c_str(), source.size()));
+  }
+  std::remove(path.c_str());
+  CHECK_THROWS(TokenFile(path.c_str(), source.size()));
+}
+
+TEST_CASE("TokenFile rejects corrupted files") {
+  std::string source = make_source();
+  std::string path = test::temp_path("clex_token_file_test.tok");
+  Lex lex{std::string_view(source)};
+  lex.parse();
+  save(path, lex, true);
+  const std::string data = read_file(path);
+  const Layout layout(data);
+  const size_t count = lex.tokens().size();
+
+  auto rejects = [&](const char *what, const std::string &corrupt) {
+    CAPTURE(what);
+    write_file(path, corrupt);
+    CHECK_THROWS(TokenFile(path.c_str(), source.size()));
+  };
+
+  std::string bad = data;
+  bad[0] = 'X';
+  rejects("magic", bad);
+
+  bad = data;
+  patch(bad, offsetof(TokenFile::Header, version), uint32_t(99));
+  rejects("version", bad);
+
+  bad = data;
+  patch(bad, offsetof(TokenFile::Header, count), uint64_t(1) << 40);
+  rejects("count", bad);
+
+  bad = data;
+  patch(bad, offsetof(TokenFile::Header, diagnostics), uint32_t(1) << 30);
+  rejects("diagnostic count", bad);
+
+  bad = data;
+  bad[layout.kinds] = static_cast<char>(Token::TokenType::Null);
+  rejects("kind", bad);
+
+  bad = data;
+  for (size_t i = 0; i < count; i++) {
+    if (lex.tokens().type(i) == Token::TokenType::OP) {
+      bad[layout.subtypes + i] = static_cast<char>(200);
+      break;
+    }
+  }
+  rejects("operator", bad);
+
+  bad = data;
+  patch(bad, layout.lengths + 4 * (count - 1), uint32_t(source.size()));
+  rejects("length past the input", bad);
+
+  bad = data;
+  patch(bad, layout.lines, uint32_t(source.size()));
+  rejects("newline past the input", bad);
+
+  bad = data;
+  patch(bad, layout.checkpoints + sizeof(TokenFile::Checkpoint) +
+                 offsetof(TokenFile::Checkpoint, pos),
+        uint32_t(0));
+  rejects("checkpoint", bad);
+
+  bad = data;
+  // 所有变长整数都没有结束位，解码时会读出偏移列
+  for (size_t at = layout.offsets; at < layout.texts; at++) {
+    bad[at] = static_cast<char>(0x80);
+  }
+  rejects("varint", bad);
+
+  bad = data;
+  patch(bad, layout.diagnostics + offsetof(TokenFile::DiagnosticRecord, kind),
+        uint32_t(DIAGNOSTIC_KINDS));
+  rejects("diagnostic kind", bad);
+
+  bad = data;
+  patch(bad,
+        layout.diagnostics + offsetof(TokenFile::DiagnosticRecord, offset),
+        uint32_t(source.size()));
+  rejects("diagnostic past the input", bad);
+
+  // 输入比写入时短，Token 的结尾超出输入
+  write_file(path, data);
+  CHECK_THROWS(TokenFile(path.c_str(), source.size() / 2));
+  CHECK_NOTHROW(TokenFile(path.c_str(), source.size()));
+  std::remove(path.c_str());
+}
+
+TEST_CASE("TokenFile stays in bounds when any byte is corrupted") {
+  std::string source = make_source();
+  std::string path = test::temp_path("clex_token_file_test.tok");
+  Lex lex{std::string_view(source)};
+  lex.parse();
+  save(path, lex, true);
+  const std::string data = read_file(path);
+  size_t rejected = 0;
+  for (size_t at = 0; at < data.size(); at++) {
+    std::string bad = data;
+    bad[at] = static_cast<char>(bad[at] ^ 0xff);
+    write_file(path, bad);
+    try {
+      read_all(path, source);
+    } catch (const char *) {
+      rejected++;
+    }
+  }
+  // 头部、类型列和偏移列的改动都会被发现
+  CHECK(rejected > data.size() / 4);
+  std::remove(path.c_str());
+}
@@ -0,0 +1,37 @@
+#include "doctest.h"
+#include "reader.h"
+#include "token_stream.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+TEST_CASE("TokenStream rejects tokens that end past u32") {
+  Reader reader(std::string_view("x"));
+  TokenStream tokens(&reader);
+  const uint32_t max = std::numeric_limits<uint32_t>::max();
+  CHECK_NOTHROW(tokens.push_back(Token::TokenType::Ident, 0, max - 4, 4));
+  CHECK_THROWS(tokens.push_back(Token::TokenType::Ident, 0, max - 4, 5));
+  CHECK_THROWS(tokens.push_back(Token::TokenType::Ident, 0, max, 1));
+  CHECK(tokens.size() == 1);
+}
+
+TEST_CASE("TokenStream iterators work with standard algorithms") {
+  Reader reader(std::string_view("a+b"));
+  TokenStream tokens(&reader);
+  tokens.push_back(Token::TokenType::Ident, 0, 0, 1);
+  tokens.push_back(Token::TokenType::OP, static_cast<uint8_t>(OpType::ADD), 1,
+                   1);
+  tokens.push_back(Token::TokenType::Ident, 0, 2, 1);
+  CHECK(std::distance(tokens.begin(), tokens.end()) == 3);
+  auto op = std::find_if(tokens.begin(), tokens.end(),
+                         [](const Token &t) { return t.is_op(); });
+  REQUIRE(op != tokens.end());
+  CHECK((*op).as_op() == OpType::ADD);
+  CHECK(op - tokens.begin() == 1);
+  CHECK(1 + tokens.begin() == op);
+  CHECK(tokens.begin() < op);
+  CHECK(op <= op);
+  CHECK(tokens.end() > op);
+  CHECK(tokens.end() >= op);
+}